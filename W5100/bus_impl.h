@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef BUS_IMPL_H
+#define BUS_IMPL_H
+
+#include "w5100_defs.h"
+
+/*
+ * Parallel bus interface, alternative to the SPI one. The chip is wired to
+ * the host's external memory controller, so that its bus addresses are
+ * mapped to a memory region: Bus_base() returns its start address
+ */
+
+void Bus_init();
+
+volatile uint8 *Bus_base();
+
+/* mode register checks done by IndirectBus while waiting for a software
+   reset to end. If the reset does not end the wait is given up, and the
+   driver's own reset wait, checking MR, reports the failure */
+const unsigned int BUS_RESET_ATTEMPTS = 0xFFFF;
+
+/*
+ * Bus access policies the driver class template can be instantiated with,
+ * in place of the SPI transport ones. A policy is a class providing:
+ * - void init(): starts the bus and configures the interface mode
+ * - void read(uint16 address, uint8 *data, uint16 len): reads a block
+ * - void write(uint16 address, const uint8 *data, uint16 len): writes a block
+ * where address is chip's memory address
+ */
+
+/**
+ * Direct mode: the whole chip's memory is mapped to the host's address
+ * space. A memory-mapped stand-in, such as a RAM buffer, can take the
+ * chip's place to test the driver without hardware
+ */
+class DirectBus
+{
+public:
+    DirectBus(volatile uint8 *base = Bus_base()) : base(base) { }
+    
+    void init() { Bus_init(); }
+    
+    void read(uint16 address, uint8 *data, uint16 len)
+    {
+        volatile uint8 *src = base + address;
+        for(uint16 i = 0; i < len; i++)
+            data[i] = src[i];
+    }
+    
+    void write(uint16 address, const uint8 *data, uint16 len)
+    {
+        volatile uint8 *dst = base + address;
+        for(uint16 i = 0; i < len; i++)
+            dst[i] = data[i];
+    }
+    
+private:
+    volatile uint8 *base;
+};
+
+/**
+ * Indirect mode: only four bus addresses are used, that is mode register,
+ * address register and data register. Address register is loaded once per
+ * block and auto-incremented by the chip at each data register access
+ */
+class IndirectBus
+{
+public:
+    IndirectBus(volatile uint8 *base = Bus_base()) : base(base) { }
+    
+    void init()
+    {
+        Bus_init();
+        base[IDM_MR] = MR_IND | MR_AI;
+    }
+    
+    void read(uint16 address, uint8 *data, uint16 len)
+    {
+        base[IDM_AR0] = address >> 8;
+        base[IDM_AR1] = address & 0x00FF;
+        
+        for(uint16 i = 0; i < len; i++)
+            data[i] = base[IDM_DR];
+    }
+    
+    void write(uint16 address, const uint8 *data, uint16 len)
+    {
+        if(address == MR && len > 0)
+        {
+            writeMode(data[0]);
+            address++;
+            data++;
+            len--;
+        }
+        
+        base[IDM_AR0] = address >> 8;
+        base[IDM_AR1] = address & 0x00FF;
+        
+        for(uint16 i = 0; i < len; i++)
+            base[IDM_DR] = data[i];
+    }
+    
+private:
+    
+    /* mode register is written directly, keeping interface mode bits set.
+       A software reset clears them, so they are restored once it ends */
+    void writeMode(uint8 value)
+    {
+        base[IDM_MR] = value | MR_IND | MR_AI;
+        
+        if(value & MR_RST)
+        {
+            for(unsigned int i = 0; i < BUS_RESET_ATTEMPTS; i++)
+            {
+                if(!(base[IDM_MR] & MR_RST))
+                    break;
+            }
+            
+            base[IDM_MR] = MR_IND | MR_AI;
+        }
+    }
+    
+    volatile uint8 *base;
+};
+
+#endif // BUS_IMPL_H
@@ -37,3 +37,46 @@ void Spi_CS_low()
 {
 
 }
+
+#if defined(W5100_SPI_FRAME_STREAM)
+bool Spi_transferFrames(const unsigned char *, unsigned char *,
+                        unsigned int, unsigned int)
+{
+    return false;
+}
+#endif // W5100_SPI_FRAME_STREAM
+
+
+/* Wrappers adapting the functions above to the SpiTransport interface,
+   no need to edit them */
+
+static void defaultInit(void *)
+{
+    Spi_init();
+}
+
+static unsigned char defaultSendRecv(void *, unsigned char data)
+{
+    return Spi_sendRecv(data);
+}
+
+static void defaultCsHigh(void *)
+{
+    Spi_CS_high();
+}
+
+static void defaultCsLow(void *)
+{
+    Spi_CS_low();
+}
+
+SpiTransport Spi_defaultTransport()
+{
+    SpiTransport transport;
+    transport.init = defaultInit;
+    transport.sendRecv = defaultSendRecv;
+    transport.csHigh = defaultCsHigh;
+    transport.csLow = defaultCsLow;
+    transport.ctx = 0;
+    return transport;
+}
@@ -23,6 +23,8 @@
 #ifndef SPI_IMPL_H
 #define SPI_IMPL_H
 
+#include "../common/lock_policy.h"
+
 void Spi_init();
 
 unsigned char Spi_sendRecv(unsigned char data);
@@ -31,4 +33,117 @@ void Spi_CS_high();
 
 void Spi_CS_low();
 
+/**
+ * Transfers a stream of fixed size frames with a single block transfer,
+ * for example through DMA, chip select being pulsed by the SPI peripheral
+ * between consecutive frames. Used only when W5100_SPI_FRAME_STREAM is
+ * defined, in which case it has to be implemented in spi_impl.cpp
+ * \param tx: bytes to be sent
+ * \param rx: buffer for the bytes received, null if they are not needed
+ * \param len: number of bytes, multiple of frameSize
+ * \param frameSize: frame size in bytes
+ * \return false if block transfers are not supported, in which case nothing
+ * has been sent and the driver falls back to single byte transfers
+ */
+bool Spi_transferFrames(const unsigned char *tx, unsigned char *rx,
+                        unsigned int len, unsigned int frameSize);
+
+/**
+ * SPI transport a driver instance is bound to: bus access functions plus
+ * a user defined context passed to them, which identifies for example
+ * the SPI peripheral and the chip select line to be used
+ */
+struct SpiTransport
+{
+    void (*init)(void *ctx);
+    unsigned char (*sendRecv)(void *ctx, unsigned char data);
+    void (*csHigh)(void *ctx);
+    void (*csLow)(void *ctx);
+    void *ctx;
+};
+
+/**
+ * \return a transport built on top of the functions above
+ */
+SpiTransport Spi_defaultTransport();
+
+/*
+ * Transport policies the driver class template can be instantiated with.
+ * A policy is a class providing:
+ * - void init(): starts the bus if needed
+ * - void select(): asserts chip select
+ * - void deselect(): deasserts chip select
+ * - unsigned char transfer(unsigned char data): exchanges one byte
+ * and optionally:
+ * - DriverMutex *busLock(): lock shared by the policies of all the chips
+ *   attached to the same SPI bus, see SpiRuntime
+ * - bool transferFrames(const unsigned char *tx, unsigned char *rx,
+ *   unsigned int len, unsigned int frameSize): block transfer of a frame
+ *   stream with per-frame chip select, see Spi_transferFrames()
+ * A board port can supply its own policy, accessing SPI peripheral registers
+ * directly from inline member functions so that they are inlined into the
+ * driver's transfer loops
+ */
+
+/**
+ * Default policy, using the Spi_ functions defined in spi_impl.cpp. It
+ * provides transferFrames() only if W5100_SPI_FRAME_STREAM is defined, so
+ * that without a block transfer no frame stream is encoded at all
+ */
+class SpiFunctions
+{
+public:
+    void init() { Spi_init(); }
+    void select() { Spi_CS_low(); }
+    void deselect() { Spi_CS_high(); }
+    unsigned char transfer(unsigned char data) { return Spi_sendRecv(data); }
+    
+#if defined(W5100_SPI_FRAME_STREAM)
+    bool transferFrames(const unsigned char *tx, unsigned char *rx,
+                        unsigned int len, unsigned int frameSize)
+    {
+        return Spi_transferFrames(tx, rx, len, frameSize);
+    }
+#endif // W5100_SPI_FRAME_STREAM
+};
+
+/**
+ * Policy forwarding to a SpiTransport chosen at run time, used to drive
+ * several chips attached to different buses or chip select lines. Chips
+ * sharing one SPI bus, even of different models, have to be given the same
+ * bus lock, so that their frames are not interleaved on the bus
+ */
+class SpiRuntime
+{
+public:
+    SpiRuntime(const SpiTransport& transport = Spi_defaultTransport(), DriverMutex *bus = 0) :
+        t(transport), bus(bus) { }
+    
+    void init() { t.init(t.ctx); }
+    void select() { t.csLow(t.ctx); }
+    void deselect() { t.csHigh(t.ctx); }
+    unsigned char transfer(unsigned char data) { return t.sendRecv(t.ctx, data); }
+    DriverMutex *busLock() { return bus; }
+    
+private:
+    SpiTransport t;
+    DriverMutex *bus;   //lock of the bus, null if not shared
+};
+
+/**
+ * Tells whether a transport policy provides transferFrames()
+ */
+template<class T>
+class HasFrameTransfer
+{
+    template<class U>
+    static char check(decltype(&U::transferFrames));
+    
+    template<class U>
+    static long check(...);
+    
+public:
+    static const bool value = sizeof(check<T>(0)) == sizeof(char);
+};
+
 #endif // SPI_IMPL_H
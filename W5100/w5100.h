@@ -23,259 +23,315 @@
 
 #include "w5100_defs.h"
 #include "spi_impl.h"
+#include "bus_impl.h"
+#include "../common/w5x00_core.h"
 #include <cstdio>
 
-typedef uint8 SOCKET;
+/**
+ * W5100 chip description for the driver core, see w5x00_core.h
+ */
+struct W5100Traits
+{
+    typedef uint16 Address;
+    
+    static const unsigned char MAX_SOCK_NUM = ::MAX_SOCK_NUM;
+    
+    static const Address MR   = ::MR;
+    static const Address GAR  = GAR_BASE;
+    static const Address SUBR = SUBR_BASE;
+    static const Address SHAR = SHAR_BASE;
+    static const Address SIPR = SIPR_BASE;
+    static const Address IR   = ::IR;
+    static const Address IMR  = IR_MASK;
+    static const Address RTR  = RTR_BASE;
+    static const Address RCR  = ::RCR;
+    
+    /* sockets are flagged in the lower nibble of IR and masked in IMR */
+    static const Address SOCK_IR  = ::IR;
+    static const Address SOCK_IMR = IR_MASK;
+    static const uint8 SOCK_IR_BITS = 0x0F;
+    static const bool SOCK_IMR_SHARED = true;
+    
+    /* no interrupt low level timer, PHY or socket fragment registers */
+    static const bool HAS_INTLEVEL = false;
+    static const Address INTLEVEL = 0;
+    static const uint16 INTLEVEL_MAX_DELAY = 0;
+    static const bool HAS_PHY = false;
+    static const Address PHY = 0;
+    static const bool HAS_SOCK_FRAG = false;
+    
+    /* sockets have IPRAW mode, whose protocol is set in Sn_PROTO */
+    static const bool HAS_IPRAW = true;
+    
+    static Address socketReg(uint8 sockNum, uint16 offset)
+    {
+        return SR_BASE + sockNum * SR_SIZE + offset;
+    }
+    
+    static Address txBuffer(uint8, uint16 offset) { return TX_BUF_BASE + offset; }
+    static Address rxBuffer(uint8, uint16 offset) { return RX_BUF_BASE + offset; }
+    static const bool BUFFER_WRAP_IN_CHIP = false;
+    
+    /* RMSR and TMSR hold two bits per socket, socket 0 in the lowest */
+    static Address memSizeReg(uint8, bool tx) { return tx ? TMSR : RMSR; }
+    
+    static uint8 memSizeValue(uint8 current, uint8 sockNum, uint8 memSize)
+    {
+        /* the memory configuration bits value is simply the
+           base 2 logarithm of desired size in kB */
+        uint8 bits = 0;
+        while(memSize >>= 1) bits++;
+        
+        current &= ~(0x03 << (2 * sockNum));
+        return current | (bits << (2 * sockNum));
+    }
+    
+    static const bool MEM_SIZE_SHARED = true;
+    
+    /* 8kB of TX and 8kB of RX memory shared among the sockets */
+    static const uint8 MEM_TOTAL_KB = 8;
+    
+    /* MR to TMSR, the memory size registers included */
+    static const Address COMMON_BLOCK_END = TMSR + 1;
+    
+    /* MR bits set by the interface rather than by the configuration */
+    static const uint8 MR_INTERFACE_BITS = 0;
+    
+    static const uint16 CHIP_ID = 5100;
+    
+    /* every byte is transferred in its own four bytes frame */
+    static const bool BURST_FRAMES = false;
+    
+    /* frames encoded at once for a block transfer, bounds the size
+       of the encoding buffers, which are allocated on the stack */
+    static const uint16 FRAME_CHUNK = 32;
+    static const uint16 FRAME_SIZE = 4;
+    
+    /**
+     * Reads a block of chip's memory, one SPI frame per byte
+     */
+    template<class Transport>
+    static void read(Transport& spi, Address address, uint8 *data, uint16 len)
+    {
+        readFrames(spi, address, data, len, Tag<HasFrameTransfer<Transport>::value>());
+    }
+    
+    /**
+     * Writes a block of chip's memory, one SPI frame per byte
+     */
+    template<class Transport>
+    static void write(Transport& spi, Address address, const uint8 *data, uint16 len)
+    {
+        writeFrames(spi, address, data, len, Tag<HasFrameTransfer<Transport>::value>());
+    }
+    
+    /* selects frame encoding, true if the transport has block transfers */
+    template<bool B>
+    struct Tag { };
+    
+    template<class Transport>
+    static void readFrames(Transport& spi, Address address, uint8 *data, uint16 len, Tag<false>)
+    {
+        for(uint16 i = 0; i < len; i++)
+        {
+            spi.select();
+            
+            spi.transfer(0x0F);                         // read opcode
+            spi.transfer(address >> 8);                 // Address byte 1
+            spi.transfer(address & 0x00FF);             // Address byte 2
+            address++;
+            data[i] = spi.transfer(0x00);               // Data read
+            
+            spi.deselect();
+        }
+    }
+    
+    template<class Transport>
+    static void writeFrames(Transport& spi, Address address, const uint8 *data, uint16 len, Tag<false>)
+    {
+        for(uint16 i = 0; i < len; i++)
+        {
+            spi.select();
+            
+            spi.transfer(0xF0);                         // write opcode
+            spi.transfer(address >> 8);                 // Address byte 1
+            spi.transfer(address & 0x00FF);             // Address byte 2
+            address++;
+            spi.transfer(data[i]);                      // Data write
+            
+            spi.deselect();
+        }
+    }
+    
+    /* the whole payload is encoded as a stream of frames, up to FRAME_CHUNK
+       at a time, and handed to the transport's block transfer */
+    template<class Transport>
+    static void readFrames(Transport& spi, Address address, uint8 *data, uint16 len, Tag<true>)
+    {
+        uint8 tx[FRAME_CHUNK * FRAME_SIZE];
+        uint8 rx[FRAME_CHUNK * FRAME_SIZE];
+        
+        while(len > 0)
+        {
+            uint16 n = len < FRAME_CHUNK ? len : FRAME_CHUNK;
+            
+            for(uint16 i = 0; i < n; i++, address++)
+                encodeFrame(tx + i * FRAME_SIZE, 0x0F, address, 0x00);
+            
+            sendFrames(spi, tx, rx, n * FRAME_SIZE);
+            
+            for(uint16 i = 0; i < n; i++)
+                data[i] = rx[i * FRAME_SIZE + 3];
+            
+            data += n;
+            len -= n;
+        }
+    }
+    
+    template<class Transport>
+    static void writeFrames(Transport& spi, Address address, const uint8 *data, uint16 len, Tag<true>)
+    {
+        uint8 tx[FRAME_CHUNK * FRAME_SIZE];
+        
+        while(len > 0)
+        {
+            uint16 n = len < FRAME_CHUNK ? len : FRAME_CHUNK;
+            
+            for(uint16 i = 0; i < n; i++, address++)
+                encodeFrame(tx + i * FRAME_SIZE, 0xF0, address, data[i]);
+            
+            sendFrames(spi, tx, 0, n * FRAME_SIZE);
+            
+            data += n;
+            len -= n;
+        }
+    }
+    
+    static void encodeFrame(uint8 *frame, uint8 opcode, Address address, uint8 data)
+    {
+        frame[0] = opcode;
+        frame[1] = address >> 8;
+        frame[2] = address & 0x00FF;
+        frame[3] = data;
+    }
+    
+    /* block transfer of a frame stream, falling back to byte transfers
+       when the transport turns it down at run time */
+    template<class Transport>
+    static void sendFrames(Transport& spi, const uint8 *tx, uint8 *rx, uint16 len)
+    {
+        if(spi.transferFrames(tx, rx, len, FRAME_SIZE))
+            return;
+        
+        for(uint16 i = 0; i < len; i += FRAME_SIZE)
+        {
+            spi.select();
+            
+            for(uint16 j = i; j < i + FRAME_SIZE; j++)
+            {
+                uint8 r = spi.transfer(tx[j]);
+                if(rx)
+                    rx[j] = r;
+            }
+            
+            spi.deselect();
+        }
+    }
+};
+
+/**
+ * W5100 chip attached through the parallel bus, see bus_impl.h. Blocks are
+ * transferred by the bus policy, loading the address once per block in
+ * indirect mode
+ */
+struct W5100BusTraits : public W5100Traits
+{
+    static const bool BURST_FRAMES = true;
+    
+    /* indirect mode keeps its interface mode bits set in MR */
+    static const uint8 MR_INTERFACE_BITS = MR_IND | MR_AI;
+    
+    template<class Bus>
+    static void read(Bus& bus, Address address, uint8 *data, uint16 len)
+    {
+        bus.read(address, data, len);
+    }
+    
+    template<class Bus>
+    static void write(Bus& bus, Address address, const uint8 *data, uint16 len)
+    {
+        bus.write(address, data, len);
+    }
+};
+
+/**
+ * Maps an interface policy to the chip traits driving it: SPI traits for
+ * SPI transport policies, bus traits for the bus policies
+ */
+template<class Interface>
+struct W5100TraitsFor { typedef W5100Traits type; };
+
+template<>
+struct W5100TraitsFor<DirectBus> { typedef W5100BusTraits type; };
+
+template<>
+struct W5100TraitsFor<IndirectBus> { typedef W5100BusTraits type; };
 
-// extern W5100& w5100; //a W5100 driver class instance
+/* interface used by default, selected at build time defining either
+   W5100_BUS_DIRECT or W5100_BUS_INDIRECT, SPI when none is defined */
+#if defined(W5100_BUS_DIRECT)
+typedef DirectBus W5100DefaultInterface;
+#elif defined(W5100_BUS_INDIRECT)
+typedef IndirectBus W5100DefaultInterface;
+#else
+typedef SpiFunctions W5100DefaultInterface;
+#endif
 
-class W5100
+/**
+ * Driver class template for W5100 chip, socket numbers range
+ * between 0 and 3
+ * \param Transport: SPI transport policy, see spi_impl.h, or parallel bus
+ * policy, see bus_impl.h
+ */
+template<class Transport = W5100DefaultInterface>
+class W5100T : public W5x00Core<typename W5100TraitsFor<Transport>::type, Transport>
 {
 public:
-   
-    /**
-     * \return a singleton instance of W5100 class
-     */
-    static W5100& instance();
-    
-    /**
-     * Set chip's MAC address
-     */
-    void setMacAddress(uint8 *address);
-    
-    /**
-     * Set chip's IP address
-     */
-    void setIpAddress(uint8 *address);
-    
-    /**
-     * Set network's subnet mask
-     */
-    void setSubnetMask(uint8 *mask);
-    
-    /**
-     * Set network's gateway IP address
-     */
-    void setGatewayAddress(uint8 *address);
-    
-    /**
-     * Set Mode register flags
-     */
-    void setModeReg(uint8 value);
-    
-    /**
-     * Set retransmission timeout period in units of 100us each
-     * for example to set timeout period to 400ms you have to set
-     * this register to 0x4000
-     */
-    void setRetryTime(uint16 value);
-    
-    /**
-     * Configures the number of retransmissions
-     */
-    void setRetryCount(uint16 value);
-    
-    /**
-     * Configures the interrupt mask for socket interrupts
-     */    
-    void setInterruptMask(uint8 mask);
-    
-    /**
-     * \return chip's interrupt register value
-     */    
-    uint8 readInterruptReg();    
-        
-    /**
-     * Writes socket's mode register
-     * \param sockNum: socket number, between 0 and 3
-     * \param value: value to be written
-     */
-    void setSocketModeReg(SOCKET sockNum, uint8 value);
-    
-    /**
-     * Used to send a command to a socket through its command register
-     * \param sockNum: socket number, between 0 and 3
-     * \param value: command opcode
-     */
-    void setSocketCommandReg(SOCKET sockNum, uint8 value);
-    
-    /**
-     * Used to get register's value, as a way to check if a given command is completed
-     * \param sockNum: socket number, between 0 and 3
-     * \return register's value
-     */
-    uint8 getSocketCommandReg(SOCKET sockNum);
-    
-    /**
-     * Reads socket's interrupt register
-     * \param sockNum: socket number, between 0 and 3
-     * \return socket's interrupt register value
-     */
-    uint8 getSocketInterruptReg(SOCKET sockNum);
-    
-    /**
-     * Reads socket's status register
-     * \param sockNum: socket number, between 0 and 3
-     * \return socket's status register value
-     */
-    uint8 getSocketStatusReg(SOCKET sockNum);
-    
-    /**
-     * Sets socket's source port value, both for TCP and UDP
-     * \param sockNum: socket number, between 0 and 3
-     * \param port: socket's source port number
-     */
-    void setSocketSourcePort(SOCKET sockNum, uint16 port);
-    
-    /**
-     * Sets socket's destination MAC address
-     * \param sockNum: socket number, between 0 and 3
-     * \param destMAC: socket's destination MAC address
-     */
-    void setSocketDestMac(SOCKET sockNum, uint8* destMAC);
-    
-    /**
-     * Sets socket's destination IP address 
-     * \param sockNum: socket number, between 0 and 3
-     * \param destIP: socket's destination IP address
-     */
-    void setSocketDestIp(SOCKET sockNum, uint8 *destIP);
-    
-    /**
-     * Sets socket's destination port number
-     * \param sockNum: socket number, between 0 and 3
-     * \param value: socket's destination port number
-     */
-    void setSocketDestPort(SOCKET sockNum, uint16 destPort);
-    
-    /**
-     * Set socket's Maximum Segment Size for TCP mode
-     * \param sockNum: socket number, between 0 and 3
-     * \param value: MSS value
-     */
-    void setSocketMSS(SOCKET sockNum, uint16 value);
-    
-    /**
-     * Set socket's protocol number when used in IPraw mode
-     * \param sockNum: socket number, between 0 and 3
-     * \param value: protocol number
-     */
-    void setSocketProtocolValue(SOCKET sockNum, uint8 value);
-    
-    /**
-     * Sets Type Of Service field value in socket's IP header
-     * \param sockNum: socket number, between 0 and 3
-     * \param TOSvalue: field value
-     */
-    void setSocketTos(SOCKET sockNum, uint8 TOSvalue);
-    
-    /**
-     * Sets Time To Live field value in socket's IP header
-     * \param sockNum: socket number, between 0 and 3
-     * \param TTLvalue: field value
-     */
-    void setSocketTtl(SOCKET sockNum, uint8 TTLvalue);
-    
-    /**
-     * Configures socket's internal RX memory size
-     * Accepted values are: 1, 2, 4 and 8kB
-     * \param sockNum: socket number, between 0 and 3
-     * \param memSize: desired RX memory size
-     */
-    void setSocketRxMemSize(SOCKET sockNum, uint8 memSize);
-    
-    /**
-     * Configures socket's internal TX memory size
-     * Accepted values are: 1, 2, 4 and 8kB
-     * \param sockNum: socket number, between 0 and 3
-     * \param memSize: desired TX memory size
-     */
-    void setSocketTxMemSize(SOCKET sockNum, uint8 memSize);
-    
-    /**
-     * Writes data into socket TX buffer and updates in-chip pointer
-     * \param sockNum: socket number, between 0 and 3
-     * \param data: pointer to buffer containing data to be written
-     * \param len: number of bytes to be written
-     */
-    void writeData(SOCKET sockNum, uint8 *data, uint16 len);
-    
+
     /**
-     * Reads data from socket RX buffer and updates in-chip pointer
-     * \param sockNum: socket number, between 0 and 3
-     * \param data: pointer to buffer in which write data
-     * \param len: number of bytes to be read
+     * Creates a driver instance for a chip attached to the given transport,
+     * several instances can coexist as long as they use different chip
+     * select lines or bus regions
+     * \param transport: SPI transport or bus policy object the chip is
+     * attached to
      */
-    void readData(SOCKET sockNum, uint8 *data, uint16 len);
+    explicit W5100T(const Transport& transport = Transport());
     
     /**
-     * \param sockNum: socket number, between 0 and 3
-     * \return the received data size in byte
+     * \return the instance of W5100 class driving the chip attached to a
+     * default constructed transport, which is the one provided by the Spi_
+     * functions for the default transport policy
      */
-    uint16 getReceivedSize(SOCKET sockNum);
-    
+    static W5100T& instance();
+
 private:
+
+    typedef W5x00Core<typename W5100TraitsFor<Transport>::type, Transport> Core;
     
-    W5100();
-    
-    /**
-     * Write one byte into chip's register
-     * \param address: register's address
-     * \param data: data to be written
-     */
-    void writeRegister(uint16 address, uint8 data);
-    
-    /**
-     * Write multiple bytes into chip's memory
-     * \param address: writing process start point address
-     * \param data: pointer to the data to be written
-     * \param len: number of bytes to be written
-     */
-    void writeBuffer(uint16 address, volatile uint8 *data, uint16 len);
-    
-    /**
-     * Read one byte from chip's register
-     * \param address: register's address
-     * \return data read
-     */
-    uint8 readRegister(uint16 address);
-    
-    /**
-     * Read multiple bytes into chip's memory
-     * \param address: reading process start point address
-     * \param data: pointer to the data to be read
-     * \param len: number of bytes to be read
-     */
-    void readBuffer(uint16 address, volatile uint8 *data, uint16 len);
-    
-    /**
-     * This function is used to copy data from application buffer to socket's 
-     * in-chip TX buffer
-     * 
-     * TODO: better description
-     *     
-     * \param socket: socket number, between 0 and 3
-     * \param src: pointer to source buffer
-     * \param dst: destination buffer start address. This start address is referred to chip's buffer!!
-     * \param len: number of bytes to be copied
-     */
-    void writeTxBuf(SOCKET socket, volatile uint8 *src, uint16 dst, uint16 len);
-    
-    /**
-     * This function is used to copy data from socket's in-chip TX buffer
-     * to application buffer
-     * 
-     * TODO: better description
-     * 
-     * \param socket: socket number, between 0 and 3
-     * \param src: source buffer start address. This start address is referred to chip's buffer!!
-     * \param dst: pointer to destination buffer
-     * \param len: number of bytes to be copied
-     */
-    void readRxBuf(SOCKET socket, uint16 src, volatile uint8 *dst, uint16 len);
-    
-    uint16 txBufSize[MAX_SOCK_NUM];   //sockets TX buffer size in byte
-    uint16 rxBufSize[MAX_SOCK_NUM];   //sockets RX buffer size in byte
+    W5100T(const W5100T&);
+    W5100T& operator=(const W5100T&);
 };
 
+#include "w5100_impl.h"
+
+/* instantiated in w5100.cpp */
+extern template class W5x00Core<W5100TraitsFor<W5100DefaultInterface>::type, W5100DefaultInterface>;
+extern template class W5100T<W5100DefaultInterface>;
+
+/**
+ * Driver for a chip attached to the Spi_ functions or, in bus mode, to
+ * the bus region returned by Bus_base()
+ */
+typedef W5100T<> W5100;
+
 #endif // W5100_H
@@ -0,0 +1,39 @@
+/*
+ * Driver class for Wiznet W5100 chip, member functions definitions
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+/*
+ * Included by w5100.h, do not include this file directly
+ */
+
+#ifndef W5100_IMPL_H
+#define W5100_IMPL_H
+
+template<class Transport>
+W5100T<Transport>::W5100T(const Transport& transport)
+    : Core(transport) { }
+
+template<class Transport>
+W5100T<Transport>& W5100T<Transport>::instance()
+{
+    static W5100T instance;
+    return instance;
+}
+
+#endif // W5100_IMPL_H
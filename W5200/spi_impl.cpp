@@ -37,3 +37,38 @@ void Spi_CS_low()
 {
 
 }
+
+
+/* Wrappers adapting the functions above to the SpiTransport interface,
+   no need to edit them */
+
+static void defaultInit(void *)
+{
+    Spi_init();
+}
+
+static unsigned char defaultSendRecv(void *, unsigned char data)
+{
+    return Spi_sendRecv(data);
+}
+
+static void defaultCsHigh(void *)
+{
+    Spi_CS_high();
+}
+
+static void defaultCsLow(void *)
+{
+    Spi_CS_low();
+}
+
+SpiTransport Spi_defaultTransport()
+{
+    SpiTransport transport;
+    transport.init = defaultInit;
+    transport.sendRecv = defaultSendRecv;
+    transport.csHigh = defaultCsHigh;
+    transport.csLow = defaultCsLow;
+    transport.ctx = 0;
+    return transport;
+}
@@ -23,299 +23,155 @@
 
 #include "w5200_defs.h"
 #include "spi_impl.h"
+#include "../common/w5x00_core.h"
 
-typedef uint8_t SOCKET;
-
-// extern W5200& w5200; //a W5200 driver class instance
-
-class W5200
+/**
+ * W5200 chip description for the driver core, see w5x00_core.h
+ */
+struct W5200Traits
 {
-public:
-   
-    /**
-     * \return a singleton instance of W5200 class
-     */
-    static W5200& instance();
+    typedef uint16_t Address;
     
-    /**
-     * Set chip's MAC address
-     */
-    void setMacAddress(const uint8_t *address);
+    static const unsigned char MAX_SOCK_NUM = ::MAX_SOCK_NUM;
     
-    /**
-     * Set chip's IP address
-     */
-    void setIpAddress(uint8_t *address);
+    static const Address MR   = ::MR;
+    static const Address GAR  = GAR_BASE;
+    static const Address SUBR = SUBR_BASE;
+    static const Address SHAR = SHAR_BASE;
+    static const Address SIPR = SIPR_BASE;
+    static const Address IR   = ::IR;
+    static const Address IMR  = IR_MASK;
+    static const Address RTR  = RTR_BASE;
+    static const Address RCR  = ::RCR;
     
-    /**
-     * Set network's subnet mask
-     */
-    void setSubnetMask(uint8_t *mask);
+    /* sockets have their own summary and mask registers, IR2 and IMR2 */
+    static const Address SOCK_IR  = ::SOCK_IR;
+    static const Address SOCK_IMR = SOCK_IR_MASK;
+    static const uint8_t SOCK_IR_BITS = 0xFF;
+    static const bool SOCK_IMR_SHARED = false;
     
-    /**
-     * Set network's gateway IP address
-     */
-    void setGatewayAddress(uint8_t *address);
+    /* interrupt low level timer, PHY and socket fragment registers */
+    static const bool HAS_INTLEVEL = true;
+    static const Address INTLEVEL = INTLEVEL0;
+    static const uint16_t INTLEVEL_MAX_DELAY = ::INTLEVEL_MAX_DELAY;
+    static const bool HAS_PHY = true;
+    static const Address PHY = ::PHY;
+    static const bool HAS_SOCK_FRAG = true;
     
-    /**
-     * Set Mode register flags
-     */
-    void setModeReg(uint8_t value);
+    /* sockets have IPRAW mode, whose protocol is set in Sn_PROTO */
+    static const bool HAS_IPRAW = true;
     
-    /**
-     * Set retransmission timeout period in units of 100us each
-     * for example to set timeout period to 400ms you have to set
-     * this register to 0x4000
-     */
-    void setRetryTime(uint16_t value);
+    static Address socketReg(uint8_t sockNum, uint16_t offset)
+    {
+        return SR_BASE + sockNum * SR_SIZE + offset;
+    }
     
-    /**
-     * Configures the number of retransmissions
-     */
-    void setRetryCount(uint16_t value);
+    static Address txBuffer(uint8_t, uint16_t offset) { return TX_BUF_BASE + offset; }
+    static Address rxBuffer(uint8_t, uint16_t offset) { return RX_BUF_BASE + offset; }
+    static const bool BUFFER_WRAP_IN_CHIP = false;
     
-    /**
-     * Configures the interrupt mask for socket interrupts
-     */    
-    void setInterruptMask(uint8_t mask);
+    /* each socket has its own size registers, holding size in kB */
+    static Address memSizeReg(uint8_t sockNum, bool tx)
+    {
+        return socketReg(sockNum, tx ? Sn_TXMEM_SIZE : Sn_RXMEM_SIZE);
+    }
     
-    /**
-     * \return chip's interrupt register value
-     */    
-    uint8_t readInterruptReg();
+    static uint8_t memSizeValue(uint8_t, uint8_t, uint8_t memSize) { return memSize; }
+    static const bool MEM_SIZE_SHARED = false;
     
-    /**
-     * \return chip's IR2 register value, please refer to datasheet
-     */
-    uint8_t readSocketInterruptReg();
+    /* 16kB of TX and 16kB of RX memory shared among the sockets */
+    static const uint8_t MEM_TOTAL_KB = 16;
     
-    /**
-     * Configures chip's IMR2 register, please refer to datasheet
-     */    
-    void setSocketInterruptMask(uint8_t mask);
+    /* MR to RCR, IMR lies apart at the end of the common registers */
+    static const Address COMMON_BLOCK_END = ::RCR + 1;
     
-    /**
-     * \return value of register that indicates chip's
-     * physical status
-     */
-    uint8_t getPhyStatus();
-        
-    /**
-     * Writes socket's mode register
-     * \param sockNum: socket number, between 0 and 7
-     * \param value: value to be written
-     */
-    void setSocketModeReg(SOCKET sockNum, uint8_t value);
+    /* MR bits set by the interface rather than by the configuration */
+    static const uint8_t MR_INTERFACE_BITS = 0;
     
-    /**
-     * Used to send a command to a socket through its command register
-     * \param sockNum: socket number, between 0 and 7
-     * \param value: command opcode
-     */
-    void setSocketCommandReg(SOCKET sockNum, uint8_t value);
-    
-    /**
-     * Used to get register's value, as a way to check if a given command is completed
-     * \param sockNum: socket number, between 0 and 7
-     * \return register's value
-     */
-    uint8_t getSocketCommandReg(SOCKET sockNum);
-    
-    /**
-     * Configures the socket interrupts that will be signalled
-     * \param sockNum: socket number, between 0 and 7
-     * \param value: mask value
-     */
-    void setSocketInterruptMaskReg(SOCKET sockNum, uint8_t value);
-    
-    /**
-     * Reads socket's interrupt register
-     * \param sockNum: socket number, between 0 and 7
-     * \return socket's interrupt register value
-     */
-    uint8_t getSocketInterruptReg(SOCKET sockNum);
-    
-    /**
-     * Resets all the socket's interrupt register flags
-     * \param sockNum: socket number, between 0 and 7
-     */
-    
-    void clearSocketInterruptReg(SOCKET sockNum);
+    static const uint16_t CHIP_ID = 5200;
     
-    /**
-     * Reads socket's status register
-     * \param sockNum: socket number, between 0 and 7
-     * \return socket's status register value
-     */
-    uint8_t getSocketStatusReg(SOCKET sockNum);
-    
-    /**
-     * Sets socket's source port value, both for TCP and UDP
-     * \param sockNum: socket number, between 0 and 7
-     * \param port: socket's source port number
-     */
-    void setSocketSourcePort(SOCKET sockNum, uint16_t port);
-    
-    /**
-     * Sets socket's destination MAC address
-     * \param sockNum: socket number, between 0 and 7
-     * \param destMAC: socket's destination MAC address
-     */
-    void setSocketDestMac(SOCKET sockNum, uint8_t* destMAC);
-    
-    /**
-     * Sets socket's destination IP address 
-     * \param sockNum: socket number, between 0 and 7
-     * \param destIP: socket's destination IP address
-     */
-    void setSocketDestIp(SOCKET sockNum, uint8_t *destIP);
-    
-    /**
-     * Sets socket's destination port number
-     * \param sockNum: socket number, between 0 and 7
-     * \param value: socket's destination port number
-     */
-    void setSocketDestPort(SOCKET sockNum, uint16_t destPort);
+    static const bool BURST_FRAMES = true;
     
     /**
-     * Set socket's Maximum Segment Size for TCP mode
-     * \param sockNum: socket number, between 0 and 7
-     * \param value: MSS value
+     * Reads a block of chip's memory with a single SPI frame
      */
-    void setSocketMSS(SOCKET sockNum, uint16_t value);
-    
-    /**
-     * Set socket's protocol number when used in IPraw mode
-     * \param sockNum: socket number, between 0 and 7
-     * \param value: protocol number
-     */
-    void setSocketProtocolValue(SOCKET sockNum, uint8_t value);
-    
-    /**    W5200();
-     * Sets Type Of Service field value in socket's IP header
-     * \param sockNum: socket number, between 0 and 7
-     * \param TOSvalue: field value
-     */
-    void setSocketTos(SOCKET sockNum, uint8_t TOSvalue);
-    
-    /**
-     * Sets Time To Live field value in socket's IP header
-     * \param sockNum: socket number, between 0 and 7
-     * \param TTLvalue: field value
-     */
-    void setSocketTtl(SOCKET sockNum, uint8_t TTLvalue);
-    
-    /**
-     * Sets Fragment field value in socket's IP header
-     * \param sockNum: socket number, between 0 and 7
-     * \param value: field value
-     */
-    void setSocketFragmentValue(SOCKET sockNum, uint16_t value);
-    
-    /**
-     * Configures socket's internal RX memory size
-     * Accepted values are: 0, 1, 2, 4, 8 and 16kB
-     * \param sockNum: socket number, between 0 and 7
-     * \param memSize: desired RX memory size
-     */
-    void setSocketRxMemSize(SOCKET sockNum, uint8_t memSize);
-    
-    /**
-     * Configures socket's internal TX memory size
-     * Accepted values are: 0, 1, 2, 4, 8 and 16kB
-     * \param sockNum: socket number, between 0 and 7
-     * \param memSize: desired TX memory size
-     */
-    void setSocketTxMemSize(SOCKET sockNum, uint8_t memSize);
+    template<class Transport>
+    static void read(Transport& spi, Address address, uint8_t *data, uint16_t len)
+    {
+        spi.select();
+        
+        spi.transfer((address & 0xFF00) >> 8);          // Address byte 1
+        spi.transfer(address & 0x00FF);                 // Address byte 2
+        spi.transfer(0x00 | ((len & 0x7F00) >> 8));     // Data read command and read data length 1
+        spi.transfer(len & 0x00FF);                     // Read data length 2
+        
+        for(uint16_t i = 0; i < len; i++)
+            data[i] = spi.transfer(0x00);
+        
+        spi.deselect();
+    }
     
     /**
-     * Writes data into socket TX buffer and updates in-chip pointer
-     * \param sockNum: socket number, between 0 and 7
-     * \param data: pointer to buffer containing data to be written
-     * \param len: number of bytes to be written
+     * Writes a block of chip's memory with a single SPI frame
      */
-    void writeData(SOCKET sockNum, uint8_t *data, uint16_t len);
-    
+    template<class Transport>
+    static void write(Transport& spi, Address address, const uint8_t *data, uint16_t len)
+    {
+        spi.select();
+        
+        spi.transfer((address & 0xFF00) >> 8);          // Address byte 1
+        spi.transfer(address & 0x00FF);                 // Address byte 2
+        spi.transfer(0x80 | ((len & 0x7F00) >> 8));     // Data write command and write data length 1
+        spi.transfer(len & 0x00FF);                     // Write data length 2
+        
+        for(uint16_t i = 0; i < len; i++)
+            spi.transfer(data[i]);
+        
+        spi.deselect();
+    }
+};
+
+/**
+ * Driver class template for W5200 chip, socket numbers range
+ * between 0 and 7
+ * \param Transport: SPI transport policy, see spi_impl.h
+ */
+template<class Transport = SpiFunctions>
+class W5200T : public W5x00Core<W5200Traits, Transport>
+{
+public:
+
     /**
-     * Reads data from socket RX buffer and updates in-chip pointer
-     * \param sockNum: socket number, between 0 and 7
-     * \param data: pointer to buffer in which write data
-     * \param len: number of bytes to be read
+     * Creates a driver instance for a chip attached to the given transport,
+     * several instances can coexist as long as they use different chip
+     * select lines
+     * \param transport: SPI transport policy object the chip is attached to
+     * \param mac: chip's MAC address, if null a default one is used
      */
-    void readData(SOCKET sockNum, uint8_t *data, uint16_t len);
+    explicit W5200T(const Transport& transport = Transport(), const uint8_t *mac = 0);
     
     /**
-     * \param sockNum: socket number, between 0 and 7
-     * \return the received data size in byte
+     * \return the instance of W5200 class driving the chip attached to a
+     * default constructed transport, which is the one provided by the Spi_
+     * functions for the default transport policy
      */
-    uint16_t getReceivedSize(SOCKET sockNum);       
-    
+    static W5200T& instance();
+
 private:
-    
-    W5200();
-    
-    /**
-     * Write one byte into chip's register
-     * \param address: register's address
-     * \param data: data to be written
-     */
-    void writeRegister(uint16_t address, uint8_t data);
-    
-    /**
-     * Write multiple bytes into chip's memory
-     * \param address: writing process start point address
-     * \param data: pointer to the data to be written
-     * \param len: number of bytes to be written
-     */
-    void writeBuffer(uint16_t address, uint8_t *data, uint16_t len);
-    
-    /**
-     * Read one byte from chip's register
-     * \param address: register's address
-     * \return data read
-     */
-    uint8_t readRegister(uint16_t address);
-    
-    /**
-     * Read multiple bytes into chip's memory
-     * \param address: reading process start point address
-     * \param data: pointer to the data to be read
-     * \param len: number of bytes to be read
-     */
-    void readBuffer(uint16_t address, uint8_t *data, uint16_t len);
-    
-    /**
-     * This function is used to copy data from application buffer to socket's 
-     * in-chip TX buffer
-     * 
-     * TODO: better description
-     *     
-     * \param socket: socket number, between 0 and 7
-     * \param src: pointer to source buffer
-     * \param dst: destination buffer start address. This start address is referred to chip's buffer!!
-     * \param len: number of bytes to be copied
-     */
-//     void writeTxBuf(SOCKET socket, volatile uint8_t *src, uint16_t dst, uint16_t len);
-     void writeTxBuf(SOCKET socket, uint8_t *src, uint16_t dst, uint16_t len);
-    
-    /**
-     * This function is used to copy data from socket's in-chip TX buffer
-     * to application buffer
-     * 
-     * TODO: better description
-     * 
-     * \param socket: socket number, between 0 and 7
-     * \param src: source buffer start address. This start address is referred to chip's buffer!!
-     * \param dst: pointer to destination buffer
-     * \param len: number of bytes to be copied
-     */
-//     void readRxBuf(SOCKET socket, uint16_t src, volatile uint8_t *dst, uint16_t len);
-    void readRxBuf(SOCKET socket, uint16_t src, uint8_t *dst, uint16_t len);
-    
-    uint16_t txBufSize[MAX_SOCK_NUM];   //sockets TX buffer size in byte
-    uint16_t rxBufSize[MAX_SOCK_NUM];   //sockets RX buffer size in byte
-    
-    const uint8_t macAddress[6] = {0xde,0xad,0x00,0x00,0xbe,0xef};
+
+    W5200T(const W5200T&);
+    W5200T& operator=(const W5200T&);
 };
 
+#include "w5200_impl.h"
+
+/* instantiated in w5200.cpp */
+extern template class W5x00Core<W5200Traits, SpiFunctions>;
+extern template class W5200T<SpiFunctions>;
+
+/**
+ * Driver for a chip attached to the Spi_ functions
+ */
+typedef W5200T<> W5200;
+
 #endif // W5200_H
@@ -19,6 +19,8 @@
 #ifndef W5200_DEFS_H
 #define W5200_DEFS_H
 
+#include "../common/w5x00_defs.h"
+
 //maximum number of sockets managed by the device
 const unsigned char MAX_SOCK_NUM = 8;
 
@@ -52,6 +54,10 @@ const unsigned int PPP_MAGIC_REG   = COMMON_BASE + 0x0029;  //PPP LCP Magic numb
 const unsigned int INTLEVEL0       = COMMON_BASE + 0x0030;  //set Interrupt low level timer register
 const unsigned int INTLEVEL1       = COMMON_BASE + 0x0031;
 
+/* interrupt low level timer: assert wait time is (INTLEVEL + 1) * 4
+   PLL clock cycles, with a 150MHz PLL clock. Values in microseconds */
+const unsigned int INTLEVEL_MAX_DELAY = 1747;   //maximum delay, INTLEVEL = 0xFFFF
+
 
 /* MODE register values */
 const unsigned char MR_RST          = 0x80; //reset
@@ -69,104 +75,33 @@ const unsigned char IR_PPPoE        = 0x20; //PPPoE connection close
 const unsigned int SR_BASE         = COMMON_BASE + 0x4000;  //socket registers base address
 const unsigned int SR_SIZE         = 0x100;                 //size of each channel register map
 
-const unsigned int SOCKn_MR            = SR_BASE + 0x0000; //socket Mode register
-const unsigned int SOCKn_CR            = SR_BASE + 0x0001; //socket command register
-const unsigned int SOCKn_IR            = SR_BASE + 0x0002; //socket interrupt register
-const unsigned int SOCKn_SR            = SR_BASE + 0x0003; //socket status register
-const unsigned int SOCKn_SPORT0        = SR_BASE + 0x0004; //socket source port register
-const unsigned int SOCKn_DHAR0         = SR_BASE + 0x0006; //socket destination MAC address register
-const unsigned int SOCKn_DIPR0         = SR_BASE + 0x000C; //socket destination IP address register
-const unsigned int SOCKn_DPORT0        = SR_BASE + 0x0010; //socket destination port register
-const unsigned int SOCKn_IMR           = SR_BASE + 0x002C; //socket's interrupt mask register
-
-const unsigned int SOCKn_MSSR0         = SR_BASE + 0x0012; //socket MSS in TCP mode
-
-const unsigned int SOCKn_PROTO         = SR_BASE + 0x0014; //socket protocol number in IPRAW mode
-
-const unsigned int SOCKn_TOS           = SR_BASE + 0x0015; //socket's IP header's Type of Service field value
-const unsigned int SOCKn_TTL           = SR_BASE + 0x0016; //socket's IP header's TTL field value
-const unsigned int SOCKn_FRAG0         = SR_BASE + 0x002D; //socket's IP header's Fragment field value 
-
-const unsigned int SOCKn_RXMEM_SIZE    = SR_BASE + 0x001E; //socket's RX buffer size register
-const unsigned int SOCKn_TXMEM_SIZE    = SR_BASE + 0x001F; //socket's TX buffer size register
-
-const unsigned int SOCKn_TX_FSR0       = SR_BASE + 0x0020; //socket's TX buffer free size register
-const unsigned int SOCKn_TX_RD0        = SR_BASE + 0x0022; //socket's TX buffer read pointer address
-const unsigned int SOCKn_TX_WR0        = SR_BASE + 0x0024; //socket's TX buffer write pointer address
-
-const unsigned int SOCKn_RX_RSR0       = SR_BASE + 0x0026; //socket's received data size register
-const unsigned int SOCKn_RX_RD0        = SR_BASE + 0x0028; //socket's RX buffer read pointer address
-const unsigned int SOCKn_RX_WR0        = SR_BASE + 0x002A; //socket's RX buffer write pointer address
-
-
-
-/* SOCKn_MR values */
-const unsigned char SOCKn_MR_CLOSE     = 0x00;        //socket closed
-const unsigned char SOCKn_MR_TCP       = 0x01;        //TCP mode
-const unsigned char SOCKn_MR_UDP       = 0x02;        //UDP mode
-const unsigned char SOCKn_MR_IPRAW     = 0x03;        //IP layer raw socket
-const unsigned char SOCKn_MR_MACRAW    = 0x04;        //MAC layer raw socket
-const unsigned char SOCKn_MR_PPPOE     = 0x05;        //PPPoE mode
-const unsigned char SOCKn_MR_ND        = 0x20;        //No delayed ACK enable
-const unsigned char SOCKn_MR_MULTI     = 0x80;        //enable multicasting (only in UDP mode)
-
-/* SOCKn_CR values */
-const unsigned char SOCKn_CR_OPEN      = 0x01;        //initialize and open socket
-const unsigned char SOCKn_CR_LISTEN    = 0x02;        //wait connection request in TCP mode (Server mode)
-const unsigned char SOCKn_CR_CONNECT   = 0x04;        //send connection request in TCP mode (Client mode)
-const unsigned char SOCKn_CR_DISCON    = 0x08;        //disconnect request in TCP mode
-const unsigned char SOCKn_CR_CLOSE     = 0x10;        //close socket
-const unsigned char SOCKn_CR_SEND      = 0x20;        //send all data stored in TX buffer
-const unsigned char SOCKn_CR_SEND_MAC  = 0x21;        //send data with MAC address without ARP process (only in UDP mode)
-const unsigned char SOCKn_CR_SEND_KEEP = 0x22;        //check if TCP connection is still alive
-const unsigned char SOCKn_CR_RECV      = 0x40;        //receive data
-
-// #ifdef __DEF_IINCHIP_PPP__
-//     #define SOCKn_CR_PCON      0x23         
-//     #define SOCKn_CR_PDISCON       0x24         
-//     #define SOCKn_CR_PCR       0x25         
-//     #define SOCKn_CR_PCN       0x26        
-//     #define SOCKn_CR_PCJ       0x27        
-// #endif
-
-/* SOCKn_IR values */
-// #ifdef __DEF_IINCHIP_PPP__
-//     #define SOCKn_IR_PRECV     0x80        
-//     #define SOCKn_IR_PFAIL     0x40        
-//     #define SOCKn_IR_PNEXT     0x20        
-// #endif
-const unsigned char SOCKn_IR_CON       = 0x01;        //connection established
-const unsigned char SOCKn_IR_DISCON    = 0x02;        //disconnected (TCP mode)
-const unsigned char SOCKn_IR_RECV      = 0x04;        //some data received
-const unsigned char SOCKn_IR_TIMEOUT   = 0x08;        //Timeout occurred in ARP or TCP
-const unsigned char SOCKn_IR_SEND_OK   = 0x10;        //SEND command completed
-
-/* SOCKn_SR values */
-const unsigned char SOCK_CLOSED        = 0x00;        //socket closed
-const unsigned char SOCK_INIT          = 0x13;        //TCP init state
-const unsigned char SOCK_LISTEN        = 0x14;        //TCP server listen for connection state
-const unsigned char SOCK_SYNSENT       = 0x15;        //TCP connection request sent to server
-const unsigned char SOCK_SYNRECV       = 0x16;        //TCP connection request received from client
-const unsigned char SOCK_ESTABLISHED   = 0x17;        //TCP connection established
-const unsigned char SOCK_FIN_WAIT      = 0x18;        //TCP closing state
-const unsigned char SOCK_CLOSING       = 0x1A;        //TCP closing state
-const unsigned char SOCK_TIME_WAIT     = 0x1B;        //TCP closing state
-const unsigned char SOCK_CLOSE_WAIT    = 0x1C;        //TCP closing state
-const unsigned char SOCK_LAST_ACK      = 0x1D;        //TCP closing state
-const unsigned char SOCK_UDP           = 0x22;        //socket opened in UDP mode
-const unsigned char SOCK_IPRAW         = 0x32;        //socket opened in IP raw mode
-const unsigned char SOCK_MACRAW        = 0x42;        //socket opened in MAC raw mode
-const unsigned char SOCK_PPPOE         = 0x5F;        //socket opened in PPPoE mode
-
-/* IP PROTOCOL */
-const unsigned char IPPROTO_IP         = 0;           // Dummy for IP
-const unsigned char IPPROTO_ICMP       = 1;           // ICMP protocol
-const unsigned char IPPROTO_IGMP       = 2;           // IGMP protocol
-const unsigned char IPPROTO_GGP        = 3;           // GGP protocol
-const unsigned char IPPROTO_TCP        = 6;           // TCP
-const unsigned char IPPROTO_PUP        = 12;          // PUP
-const unsigned char IPPROTO_UDP        = 17;          // UDP
-const unsigned char IPPROTO_IDP        = 22;          // XNS idp
-const unsigned char IPPROTO_RAW        = 255;         // Raw IP packet */
+const unsigned int SOCKn_MR            = SR_BASE + Sn_MR;         //socket Mode register
+const unsigned int SOCKn_CR            = SR_BASE + Sn_CR;         //socket command register
+const unsigned int SOCKn_IR            = SR_BASE + Sn_IR;         //socket interrupt register
+const unsigned int SOCKn_SR            = SR_BASE + Sn_SR;         //socket status register
+const unsigned int SOCKn_SPORT0        = SR_BASE + Sn_SPORT0;     //socket source port register
+const unsigned int SOCKn_DHAR0         = SR_BASE + Sn_DHAR0;      //socket destination MAC address register
+const unsigned int SOCKn_DIPR0         = SR_BASE + Sn_DIPR0;      //socket destination IP address register
+const unsigned int SOCKn_DPORT0        = SR_BASE + Sn_DPORT0;     //socket destination port register
+const unsigned int SOCKn_IMR           = SR_BASE + Sn_IMR;        //socket's interrupt mask register
+
+const unsigned int SOCKn_MSSR0         = SR_BASE + Sn_MSSR0;      //socket MSS in TCP mode
+
+const unsigned int SOCKn_PROTO         = SR_BASE + Sn_PROTO;      //socket protocol number in IPRAW mode
+
+const unsigned int SOCKn_TOS           = SR_BASE + Sn_TOS;        //socket's IP header's Type of Service field value
+const unsigned int SOCKn_TTL           = SR_BASE + Sn_TTL;        //socket's IP header's TTL field value
+const unsigned int SOCKn_FRAG0         = SR_BASE + Sn_FRAG0;      //socket's IP header's Fragment field value 
+
+const unsigned int SOCKn_RXMEM_SIZE    = SR_BASE + Sn_RXMEM_SIZE; //socket's RX buffer size register
+const unsigned int SOCKn_TXMEM_SIZE    = SR_BASE + Sn_TXMEM_SIZE; //socket's TX buffer size register
+
+const unsigned int SOCKn_TX_FSR0       = SR_BASE + Sn_TX_FSR0;    //socket's TX buffer free size register
+const unsigned int SOCKn_TX_RD0        = SR_BASE + Sn_TX_RD0;     //socket's TX buffer read pointer address
+const unsigned int SOCKn_TX_WR0        = SR_BASE + Sn_TX_WR0;     //socket's TX buffer write pointer address
+
+const unsigned int SOCKn_RX_RSR0       = SR_BASE + Sn_RX_RSR0;    //socket's received data size register
+const unsigned int SOCKn_RX_RD0        = SR_BASE + Sn_RX_RD0;     //socket's RX buffer read pointer address
+const unsigned int SOCKn_RX_WR0        = SR_BASE + Sn_RX_WR0;     //socket's RX buffer write pointer address
 
 #endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+/*
+ * Driver class for Wiznet W5200 chip, member functions definitions
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+/*
+ * Included by w5200.h, do not include this file directly
+ */
+
+#ifndef W5200_IMPL_H
+#define W5200_IMPL_H
+
+template<class Transport>
+W5200T<Transport>::W5200T(const Transport& transport, const uint8_t *mac)
+    : W5x00Core<W5200Traits, Transport>(transport)
+{
+    /* MAC address used when none is provided */
+    static const uint8_t defaultMac[6] = {0xde,0xad,0x00,0x00,0xbe,0xef};
+    
+    this->setMacAddress(mac ? mac : defaultMac);
+}
+
+template<class Transport>
+W5200T<Transport>& W5200T<Transport>::instance()
+{
+    static W5200T instance;
+    return instance;
+}
+
+#endif // W5200_IMPL_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include "spi_impl.h"
+
+void Spi_init()
+{
+
+}
+
+unsigned char Spi_sendRecv(unsigned char data)
+{
+
+}
+
+void Spi_CS_high()
+{
+
+}
+
+void Spi_CS_low()
+{
+
+}
+
+
+/* Wrappers adapting the functions above to the SpiTransport interface,
+   no need to edit them */
+
+static void defaultInit(void *)
+{
+    Spi_init();
+}
+
+static unsigned char defaultSendRecv(void *, unsigned char data)
+{
+    return Spi_sendRecv(data);
+}
+
+static void defaultCsHigh(void *)
+{
+    Spi_CS_high();
+}
+
+static void defaultCsLow(void *)
+{
+    Spi_CS_low();
+}
+
+SpiTransport Spi_defaultTransport()
+{
+    SpiTransport transport;
+    transport.init = defaultInit;
+    transport.sendRecv = defaultSendRecv;
+    transport.csHigh = defaultCsHigh;
+    transport.csLow = defaultCsLow;
+    transport.ctx = 0;
+    return transport;
+}
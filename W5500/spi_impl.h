@@ -0,0 +1,105 @@
+/*
+ * This is a little set of functions that create an interface layer between
+ * the driver and the target hardware / system SPI bus handling mechanism
+ * Please edit spi_impl.cpp and NOT this file
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef SPI_IMPL_H
+#define SPI_IMPL_H
+
+#include "../common/lock_policy.h"
+
+void Spi_init();
+
+unsigned char Spi_sendRecv(unsigned char data);
+
+void Spi_CS_high();
+
+void Spi_CS_low();
+
+/**
+ * SPI transport a driver instance is bound to: bus access functions plus
+ * a user defined context passed to them, which identifies for example
+ * the SPI peripheral and the chip select line to be used
+ */
+struct SpiTransport
+{
+    void (*init)(void *ctx);
+    unsigned char (*sendRecv)(void *ctx, unsigned char data);
+    void (*csHigh)(void *ctx);
+    void (*csLow)(void *ctx);
+    void *ctx;
+};
+
+/**
+ * \return a transport built on top of the functions above
+ */
+SpiTransport Spi_defaultTransport();
+
+/*
+ * Transport policies the driver class template can be instantiated with.
+ * A policy is a class providing:
+ * - void init(): starts the bus if needed
+ * - void select(): asserts chip select
+ * - void deselect(): deasserts chip select
+ * - unsigned char transfer(unsigned char data): exchanges one byte
+ * and optionally:
+ * - DriverMutex *busLock(): lock shared by the policies of all the chips
+ *   attached to the same SPI bus, see SpiRuntime
+ * A board port can supply its own policy, accessing SPI peripheral registers
+ * directly from inline member functions so that they are inlined into the
+ * driver's transfer loops
+ */
+
+/**
+ * Default policy, using the Spi_ functions defined in spi_impl.cpp
+ */
+class SpiFunctions
+{
+public:
+    void init() { Spi_init(); }
+    void select() { Spi_CS_low(); }
+    void deselect() { Spi_CS_high(); }
+    unsigned char transfer(unsigned char data) { return Spi_sendRecv(data); }
+};
+
+/**
+ * Policy forwarding to a SpiTransport chosen at run time, used to drive
+ * several chips attached to different buses or chip select lines. Chips
+ * sharing one SPI bus, even of different models, have to be given the same
+ * bus lock, so that their frames are not interleaved on the bus
+ */
+class SpiRuntime
+{
+public:
+    SpiRuntime(const SpiTransport& transport = Spi_defaultTransport(), DriverMutex *bus = 0) :
+        t(transport), bus(bus) { }
+    
+    void init() { t.init(t.ctx); }
+    void select() { t.csLow(t.ctx); }
+    void deselect() { t.csHigh(t.ctx); }
+    unsigned char transfer(unsigned char data) { return t.sendRecv(t.ctx, data); }
+    DriverMutex *busLock() { return bus; }
+    
+private:
+    SpiTransport t;
+    DriverMutex *bus;   //lock of the bus, null if not shared
+};
+
+#endif // SPI_IMPL_H
@@ -0,0 +1,183 @@
+/*
+ * Driver class for Wiznet W5500 chip
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef W5500_H
+#define W5500_H
+
+#include "w5500_defs.h"
+#include "spi_impl.h"
+#include "../common/w5x00_core.h"
+
+/**
+ * W5500 chip description for the driver core, see w5x00_core.h
+ */
+struct W5500Traits
+{
+    /* block select in bits 16 to 20, offset within the block below */
+    typedef uint32_t Address;
+    
+    static const unsigned char MAX_SOCK_NUM = ::MAX_SOCK_NUM;
+    
+    static const Address MR   = ::MR;
+    static const Address GAR  = GAR_BASE;
+    static const Address SUBR = SUBR_BASE;
+    static const Address SHAR = SHAR_BASE;
+    static const Address SIPR = SIPR_BASE;
+    static const Address IR   = ::IR;
+    static const Address IMR  = IR_MASK;
+    static const Address RTR  = RTR_BASE;
+    static const Address RCR  = ::RCR;
+    
+    /* sockets have their own summary and mask registers, SIR and SIMR */
+    static const Address SOCK_IR  = ::SOCK_IR;
+    static const Address SOCK_IMR = SOCK_IR_MASK;
+    static const uint8_t SOCK_IR_BITS = 0xFF;
+    static const bool SOCK_IMR_SHARED = false;
+    
+    /* interrupt low level timer, PHY and socket fragment registers */
+    static const bool HAS_INTLEVEL = true;
+    static const Address INTLEVEL = INTLEVEL0;
+    static const uint16_t INTLEVEL_MAX_DELAY = ::INTLEVEL_MAX_DELAY;
+    static const bool HAS_PHY = true;
+    static const Address PHY = ::PHY;
+    static const bool HAS_SOCK_FRAG = true;
+    
+    /* sockets have no IPRAW mode, Sn_PROTO is reserved */
+    static const bool HAS_IPRAW = false;
+    
+    static Address block(uint8_t bsb, uint8_t sockNum, uint16_t offset)
+    {
+        return (static_cast<Address>(bsb + sockNum * BSB_SOCK_STRIDE) << 16) | offset;
+    }
+    
+    static Address socketReg(uint8_t sockNum, uint16_t offset)
+    {
+        return block(BSB_SOCK_REG, sockNum, offset);
+    }
+    
+    /* each socket's buffer is a block of its own, addressed by the socket's
+       buffer pointers as they are: the chip wraps them at buffer's end */
+    static Address txBuffer(uint8_t sockNum, uint16_t ptr) { return block(BSB_SOCK_TX, sockNum, ptr); }
+    static Address rxBuffer(uint8_t sockNum, uint16_t ptr) { return block(BSB_SOCK_RX, sockNum, ptr); }
+    static const bool BUFFER_WRAP_IN_CHIP = true;
+    
+    /* each socket has its own size registers, holding size in kB */
+    static Address memSizeReg(uint8_t sockNum, bool tx)
+    {
+        return socketReg(sockNum, tx ? Sn_TXMEM_SIZE : Sn_RXMEM_SIZE);
+    }
+    
+    static uint8_t memSizeValue(uint8_t, uint8_t, uint8_t memSize) { return memSize; }
+    static const bool MEM_SIZE_SHARED = false;
+    
+    /* 16kB of TX and 16kB of RX memory shared among the sockets */
+    static const uint8_t MEM_TOTAL_KB = 16;
+    
+    /* MR to RCR, interrupt masks included */
+    static const Address COMMON_BLOCK_END = ::RCR + 1;
+    
+    /* MR bits set by the interface rather than by the configuration */
+    static const uint8_t MR_INTERFACE_BITS = 0;
+    
+    static const uint16_t CHIP_ID = 5500;
+    
+    static const bool BURST_FRAMES = true;
+    
+    /**
+     * Reads a block of chip's memory with a single variable length SPI frame
+     */
+    template<class Transport>
+    static void read(Transport& spi, Address address, uint8_t *data, uint16_t len)
+    {
+        spi.select();
+        
+        spi.transfer((address & 0xFF00) >> 8);                  // Offset byte 1
+        spi.transfer(address & 0x00FF);                         // Offset byte 2
+        spi.transfer(((address >> 16) << 3) | CTRL_OM_VDM);     // Block select, read, variable length
+        
+        for(uint16_t i = 0; i < len; i++)
+            data[i] = spi.transfer(0x00);
+        
+        spi.deselect();
+    }
+    
+    /**
+     * Writes a block of chip's memory with a single variable length SPI frame
+     */
+    template<class Transport>
+    static void write(Transport& spi, Address address, const uint8_t *data, uint16_t len)
+    {
+        spi.select();
+        
+        spi.transfer((address & 0xFF00) >> 8);                  // Offset byte 1
+        spi.transfer(address & 0x00FF);                         // Offset byte 2
+        spi.transfer(((address >> 16) << 3) | CTRL_RWB_WRITE | CTRL_OM_VDM);   // Block select, write, variable length
+        
+        for(uint16_t i = 0; i < len; i++)
+            spi.transfer(data[i]);
+        
+        spi.deselect();
+    }
+};
+
+/**
+ * Driver class template for W5500 chip, socket numbers range
+ * between 0 and 7. Public interface is the same as W5200 one
+ * \param Transport: SPI transport policy, see spi_impl.h
+ */
+template<class Transport = SpiFunctions>
+class W5500T : public W5x00Core<W5500Traits, Transport>
+{
+public:
+
+    /**
+     * Creates a driver instance for a chip attached to the given transport,
+     * several instances can coexist as long as they use different chip
+     * select lines
+     * \param transport: SPI transport policy object the chip is attached to
+     * \param mac: chip's MAC address, if null a default one is used
+     */
+    explicit W5500T(const Transport& transport = Transport(), const uint8_t *mac = 0);
+    
+    /**
+     * \return the instance of W5500 class driving the chip attached to a
+     * default constructed transport, which is the one provided by the Spi_
+     * functions for the default transport policy
+     */
+    static W5500T& instance();
+
+private:
+
+    W5500T(const W5500T&);
+    W5500T& operator=(const W5500T&);
+};
+
+#include "w5500_impl.h"
+
+/* instantiated in w5500.cpp */
+extern template class W5x00Core<W5500Traits, SpiFunctions>;
+extern template class W5500T<SpiFunctions>;
+
+/**
+ * Driver for a chip attached to the Spi_ functions
+ */
+typedef W5500T<> W5500;
+
+#endif // W5500_H
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef W5500_DEFS_H
+#define W5500_DEFS_H
+
+#include "../common/w5x00_defs.h"
+
+//maximum number of sockets managed by the device
+const unsigned char MAX_SOCK_NUM = 8;
+
+/* W5500 memory is split in blocks, selected by the BSB field of each SPI
+   frame's control byte. Within the driver an address carries the block
+   number in bits 16 to 20 and the offset within the block in the lower
+   16 bits */
+
+const unsigned char BSB_COMMON      = 0x00;     //common registers block
+const unsigned char BSB_SOCK_REG    = 0x01;     //socket 0 registers block
+const unsigned char BSB_SOCK_TX     = 0x02;     //socket 0 TX buffer block
+const unsigned char BSB_SOCK_RX     = 0x03;     //socket 0 RX buffer block
+const unsigned char BSB_SOCK_STRIDE = 0x04;     //distance between two sockets' blocks
+
+/* SPI frame control byte fields */
+const unsigned char CTRL_RWB_WRITE  = 0x04;     //write access, read if clear
+const unsigned char CTRL_OM_VDM     = 0x00;     //variable length data mode, frame ends with CS
+
+/** common registers **/
+
+const unsigned int COMMON_BASE = BSB_COMMON << 16;
+
+const unsigned int MR              = COMMON_BASE + 0x0000;  //mode register address
+const unsigned int GAR_BASE        = COMMON_BASE + 0x0001;  //Gateway IP Register base address
+const unsigned int SUBR_BASE       = COMMON_BASE + 0x0005;  //Subnet mask Register base address
+const unsigned int SHAR_BASE       = COMMON_BASE + 0x0009;  //Source MAC Register base address
+const unsigned int SIPR_BASE       = COMMON_BASE + 0x000F;  //Source IP Register base address
+const unsigned int INTLEVEL0       = COMMON_BASE + 0x0013;  //set Interrupt low level timer register
+const unsigned int INTLEVEL1       = COMMON_BASE + 0x0014;
+const unsigned int IR              = COMMON_BASE + 0x0015;  //Interrupt Register address
+const unsigned int IR_MASK         = COMMON_BASE + 0x0016;  //Interrupt mask register
+const unsigned int SOCK_IR         = COMMON_BASE + 0x0017;  //Socket Interrupt Register
+const unsigned int SOCK_IR_MASK    = COMMON_BASE + 0x0018;  //Socket Interrupt mask register
+const unsigned int RTR_BASE        = COMMON_BASE + 0x0019;  //retransmission Timeout register
+const unsigned int RCR             = COMMON_BASE + 0x001B;  //retransmission count register
+
+const unsigned int PPP_TIME_REG    = COMMON_BASE + 0x001C;  //LCP Request Timer register  in PPPoE mode
+const unsigned int PPP_MAGIC_REG   = COMMON_BASE + 0x001D;  //PPP LCP Magic number register  in PPPoE mode
+
+const unsigned int UIPR0           = COMMON_BASE + 0x0028;  //unreacheable IP address register base address
+const unsigned int UPORT0          = COMMON_BASE + 0x002C;  //unreacheable port register base address
+
+const unsigned int PHY             = COMMON_BASE + 0x002E;  //PHY configuration register
+const unsigned int VERSION         = COMMON_BASE + 0x0039;  //chip version number register
+
+/* interrupt low level timer: assert wait time is (INTLEVEL + 1) * 4
+   PLL clock cycles, with a 150MHz PLL clock. Values in microseconds */
+const unsigned int INTLEVEL_MAX_DELAY = 1747;   //maximum delay, INTLEVEL = 0xFFFF
+
+
+/* MODE register values */
+const unsigned char MR_RST          = 0x80; //reset
+const unsigned char MR_WOL          = 0x20; //wake on LAN
+const unsigned char MR_PB           = 0x10; //ping block enable
+const unsigned char MR_PPPOE        = 0x08; //PPPoE enable
+const unsigned char MR_FARP         = 0x02; //force ARP
+
+/* IR register values */
+const unsigned char IR_CONFLICT     = 0x80; //IP conflict
+const unsigned char IR_UNREACH      = 0x40; //destination host unreachable
+const unsigned char IR_PPPoE        = 0x20; //PPPoE connection close
+const unsigned char IR_MP           = 0x10; //magic packet received
+
+/* PHY register values */
+const unsigned char PHY_RST         = 0x80; //PHY reset, active low
+const unsigned char PHY_OPMD        = 0x40; //operation mode set by OPMDC bits
+const unsigned char PHY_DPX         = 0x04; //full duplex
+const unsigned char PHY_SPD         = 0x02; //100Mbps speed
+const unsigned char PHY_LNK         = 0x01; //link up
+
+/* total memory available for sockets' buffers, in kB for each direction */
+const unsigned char TOTAL_BUF_SIZE  = 16;
+
+/* sockets have no IPRAW mode: Sn_PROTO and SOCKn_MR_IPRAW are not used */
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ * Adaptive partitioning of the chip's buffer memory among sockets
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef ADAPTIVE_BUFFERS_H
+#define ADAPTIVE_BUFFERS_H
+
+#include <stdint.h>
+
+/**
+ * Sizes the sockets' TX and RX buffers after the traffic observed on them,
+ * instead of the static sizes set with setSocketRxMemSize() and
+ * setSocketTxMemSize().
+ *
+ * sample(), called periodically, records for each managed socket the
+ * average RX buffer occupancy, the samples with the RX buffer near full or
+ * full, the average TX buffer occupancy and the samples with the TX buffer
+ * stalled near full. repartition(), called when sockets are closed or
+ * before opening one, turns these figures into a pressure per socket and
+ * hands out the memory in power of two sizes, each managed socket getting
+ * at least 1kB and the most pressed ones growing up to the whole memory.
+ *
+ * The chip lays buffers out in socket order, so changing a socket's size
+ * moves the buffers of all the following sockets: the new sizes are applied
+ * only if all those sockets are closed, otherwise repartition() leaves the
+ * sizes as they are and can be retried later. Sockets not managed keep
+ * their size. The driver's buffer size tables are updated together with
+ * the chip's registers.
+ *
+ * Not thread safe, sample() and repartition() have to be called from the
+ * same thread. The chip driver's header has to be included before this one.
+ * \param Chip: driver class
+ */
+template<class Chip>
+class AdaptiveBuffers
+{
+public:
+
+    /**
+     * \param chip: driver of the chip whose memory is partitioned
+     * \param sockMask: bitmask of the sockets whose buffers are managed
+     */
+    explicit AdaptiveBuffers(Chip& chip, uint8_t sockMask = 0xff)
+        : chip(chip), sockMask(sockMask)
+    {
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            rx[s] = Stats();
+            tx[s] = Stats();
+        }
+    }
+    
+    /**
+     * Records the buffer occupancy of the managed sockets, costs two
+     * register reads per socket
+     */
+    void sample()
+    {
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            if(!managed(s))
+                continue;
+            
+            uint16_t size = chip.getRxBufSize(s);
+            uint16_t used = chip.getReceivedSize(s);
+            rx[s].update(used, size);
+            
+            size = chip.getTxBufSize(s);
+            used = size - chip.getTxFreeSize(s);
+            tx[s].update(used, size);
+        }
+    }
+    
+    /**
+     * Computes the buffer sizes from the traffic observed and applies them
+     * if the sockets affected are closed
+     * \return true if the sizes now in use are the computed ones
+     */
+    bool repartition()
+    {
+        uint8_t rxKb[Chip::socketCount];
+        uint8_t txKb[Chip::socketCount];
+        
+        if(!plan(rx, false, rxKb) || !plan(tx, true, txKb))
+            return false;
+        
+        /* first socket whose buffer size changes, its buffer and
+           the following ones move */
+        SOCKET first = Chip::socketCount;
+        for(SOCKET s = 0; s < Chip::socketCount && first == Chip::socketCount; s++)
+        {
+            if((rxKb[s] << 10) != chip.getRxBufSize(s) ||
+               (txKb[s] << 10) != chip.getTxBufSize(s))
+                first = s;
+        }
+        
+        if(first == Chip::socketCount)
+            return true;
+        
+        for(SOCKET s = first; s < Chip::socketCount; s++)
+        {
+            if(chip.getSocketStatusReg(s) != SOCK_CLOSED)
+                return false;
+        }
+        
+        for(SOCKET s = first; s < Chip::socketCount; s++)
+        {
+            if((rxKb[s] << 10) != chip.getRxBufSize(s))
+                chip.setSocketRxMemSize(s, rxKb[s]);
+            
+            if((txKb[s] << 10) != chip.getTxBufSize(s))
+                chip.setSocketTxMemSize(s, txKb[s]);
+        }
+        
+        /* the new sizes change the occupancy figures, older
+           samples weigh half in the next decision */
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            rx[s].decay();
+            tx[s].decay();
+        }
+        
+        return true;
+    }
+    
+    /**
+     * \param sockNum: socket number
+     * \param isTx: true for TX buffer, false for RX buffer
+     * \return the buffer pressure used to size the socket's buffer
+     */
+    uint16_t pressure(SOCKET sockNum, bool isTx) const
+    {
+        return isTx ? tx[sockNum].pressure() : rx[sockNum].pressure();
+    }
+
+private:
+
+    AdaptiveBuffers(const AdaptiveBuffers&);
+    AdaptiveBuffers& operator=(const AdaptiveBuffers&);
+    
+    /**
+     * Traffic figures of a buffer
+     */
+    struct Stats
+    {
+        Stats() : load(0), nearFull(0), full(0) { }
+        
+        void update(uint16_t used, uint16_t size)
+        {
+            if(size == 0)
+                return;
+            
+            /* average occupancy in 1/256 units, with 1/8 weight
+               given to the last sample */
+            uint16_t occupancy = (static_cast<uint32_t>(used) << 8) / size;
+            if(occupancy > 255)
+                occupancy = 255;
+            
+            load = load - (load >> 3) + (occupancy >> 3);
+            
+            if(used >= size)
+                full = saturate(full);
+            else if(used >= size - (size >> 3))
+                nearFull = saturate(nearFull);
+        }
+        
+        uint16_t pressure() const
+        {
+            uint32_t p = load + 16 * static_cast<uint32_t>(nearFull) +
+                         32 * static_cast<uint32_t>(full);
+            return p < 0xffff ? p : 0xffff;
+        }
+        
+        void decay()
+        {
+            nearFull >>= 1;
+            full >>= 1;
+        }
+        
+        static uint16_t saturate(uint16_t v) { return v < 0xffff ? v + 1 : v; }
+        
+        uint16_t load;              //average occupancy, 1/256 units
+        uint16_t nearFull;          //samples above 7/8 of the buffer
+        uint16_t full;              //samples with buffer full
+    };
+    
+    bool managed(SOCKET s) const { return (sockMask & (1 << s)) != 0; }
+    
+    /**
+     * Hands out one direction's memory: every managed socket starts with
+     * 1kB and the one with the highest pressure per kB doubles, as long as
+     * memory is left
+     * \return false if the memory is not enough for 1kB per socket
+     */
+    bool plan(const Stats *stats, bool isTx, uint8_t *kb) const
+    {
+        int budget = Chip::bufferMemoryKb;
+        
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            uint16_t size = isTx ? chip.getTxBufSize(s) : chip.getRxBufSize(s);
+            kb[s] = managed(s) ? 1 : size >> 10;
+            budget -= kb[s];
+        }
+        
+        if(budget < 0)
+            return false;
+        
+        for(;;)
+        {
+            SOCKET best = Chip::socketCount;
+            uint32_t bestScore = 0;
+            
+            for(SOCKET s = 0; s < Chip::socketCount; s++)
+            {
+                if(!managed(s) || kb[s] > budget ||
+                   2 * kb[s] > Chip::bufferMemoryKb)
+                    continue;
+                
+                /* idle sockets still share leftover memory */
+                uint32_t score = ((stats[s].pressure() + 1UL) << 8) / kb[s];
+                if(score > bestScore)
+                {
+                    best = s;
+                    bestScore = score;
+                }
+            }
+            
+            if(best == Chip::socketCount)
+                return true;
+            
+            budget -= kb[best];
+            kb[best] *= 2;
+        }
+    }
+    
+    Chip& chip;
+    uint8_t sockMask;                   //sockets whose buffers are managed
+    Stats rx[Chip::socketCount];
+    Stats tx[Chip::socketCount];
+};
+
+#endif // ADAPTIVE_BUFFERS_H
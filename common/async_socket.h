@@ -0,0 +1,284 @@
+/*
+ * Coroutine based asynchronous socket operations
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef ASYNC_SOCKET_H
+#define ASYNC_SOCKET_H
+
+/* requires C++20 coroutines, the header is empty otherwise */
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <stdint.h>
+#include "socket_api.h"
+
+/**
+ * Return type of a coroutine run by AsyncExecutor. The coroutine starts
+ * running as soon as it is called and frees itself when it ends
+ */
+struct AsyncTask
+{
+    struct promise_type
+    {
+        AsyncTask get_return_object() { return AsyncTask(); }
+        std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * Single threaded executor of socket coroutines. Socket operations are
+ * awaitables that try the corresponding non blocking SocketLayer call and,
+ * when it would block, park the coroutine on its socket. Parked coroutines
+ * are retried, and resumed once their operation completes, by poll() for
+ * the sockets signalled in the meantime through notify(), so that sockets
+ * without events cost no SPI traffic.
+ *
+ * Events are fed from the chip's interrupt: either pass eventHandler() to
+ * drainSocketInterrupts(), or pop the SocketEventQueue filled by
+ * queueSocketEvents() with dispatch(). Without interrupts, call notify()
+ * with all the sockets before each poll().
+ *
+ * Only one coroutine at a time can wait on a socket, and everything,
+ * coroutines included, has to run in the thread calling poll(), except
+ * notify() and eventHandler(), which may be called from the interrupt
+ * handler: the notified sockets are kept in an atomic bitmask, set with
+ * fetch_or() and taken by poll() with exchange(), so that no notification
+ * is lost between the two.
+ * The chip driver's header has to be included before this one.
+ * \param Chip: driver class
+ */
+template<class Chip>
+class AsyncExecutor
+{
+public:
+
+    /**
+     * Operation a coroutine is waiting for
+     */
+    class Operation
+    {
+    public:
+        bool await_ready() { return attempt(); }
+        
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            handle = h;
+            ex.park(fd, this);
+        }
+        
+        int await_resume() { return result; }
+    
+    protected:
+        Operation(AsyncExecutor& ex, int fd) : ex(ex), fd(fd), result(0)
+        {
+            ex.layer.setNonBlocking(fd, true);
+        }
+        
+        /* true if the operation returned something other than
+           a would-block code, which is then stored in result */
+        bool completed(int value)
+        {
+            if(value == SOCKERR_WOULDBLOCK || value == SOCKERR_INPROGRESS)
+                return false;
+            
+            result = value;
+            return true;
+        }
+        
+        /**
+         * Tries the operation
+         * \return true if completed
+         */
+        virtual bool attempt() = 0;
+        
+        AsyncExecutor& ex;
+        int fd;
+        int result;
+        std::coroutine_handle<> handle;
+        
+        friend class AsyncExecutor;
+    };
+    
+    /**
+     * \param layer: socket layer the operations are performed through,
+     * sockets used by coroutines are switched to non blocking mode
+     */
+    explicit AsyncExecutor(SocketLayer<Chip>& layer) : layer(layer), pending(0u)
+    {
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+            waiting[s] = 0;
+    }
+    
+    /**
+     * Awaitable connection to a remote host, see SocketLayer::connect()
+     */
+    class ConnectOp : public Operation
+    {
+    public:
+        ConnectOp(AsyncExecutor& ex, int fd, const uint8_t *ip, uint16_t port)
+            : Operation(ex, fd), ip(ip), port(port) { }
+    
+    private:
+        bool attempt() { return this->completed(this->ex.layer.connect(this->fd, ip, port)); }
+        
+        const uint8_t *ip;
+        uint16_t port;
+    };
+    
+    /**
+     * Awaitable client connection on a listening socket, see SocketLayer::accept()
+     */
+    class AcceptOp : public Operation
+    {
+    public:
+        AcceptOp(AsyncExecutor& ex, int fd) : Operation(ex, fd) { }
+    
+    private:
+        bool attempt() { return this->completed(this->ex.layer.accept(this->fd)); }
+    };
+    
+    /**
+     * Awaitable data transmission, see SocketLayer::send()
+     */
+    class SendOp : public Operation
+    {
+    public:
+        SendOp(AsyncExecutor& ex, int fd, const uint8_t *data, uint16_t len)
+            : Operation(ex, fd), data(data), len(len) { }
+    
+    private:
+        bool attempt() { return this->completed(this->ex.layer.send(this->fd, data, len)); }
+        
+        const uint8_t *data;
+        uint16_t len;
+    };
+    
+    /**
+     * Awaitable data reception, see SocketLayer::recv()
+     */
+    class RecvOp : public Operation
+    {
+    public:
+        RecvOp(AsyncExecutor& ex, int fd, uint8_t *data, uint16_t len)
+            : Operation(ex, fd), data(data), len(len) { }
+    
+    private:
+        bool attempt() { return this->completed(this->ex.layer.recv(this->fd, data, len)); }
+        
+        uint8_t *data;
+        uint16_t len;
+    };
+    
+    /* awaitable factories, for use in co_await expressions */
+    ConnectOp connect(int fd, const uint8_t *ip, uint16_t port) { return ConnectOp(*this, fd, ip, port); }
+    AcceptOp accept(int fd) { return AcceptOp(*this, fd); }
+    SendOp send(int fd, const uint8_t *data, uint16_t len) { return SendOp(*this, fd, data, len); }
+    RecvOp recv(int fd, uint8_t *data, uint16_t len) { return RecvOp(*this, fd, data, len); }
+    
+    /**
+     * Signals that some sockets had events, their waiting coroutines will
+     * be retried by the next poll(). Can be called from interrupt context
+     * \param sockMask: bitmask of sockets
+     */
+    void notify(uint8_t sockMask) { pending.fetch_or(sockMask); }
+    
+    /**
+     * Handler to be passed to the driver's drainSocketInterrupts(), with a
+     * pointer to the executor as argument
+     */
+    static void eventHandler(SOCKET sockNum, uint8_t flags, void *arg)
+    {
+        (void) flags;
+        static_cast<AsyncExecutor *>(arg)->notify(1 << sockNum);
+    }
+    
+    /**
+     * Notifies the sockets of the events queued by the driver's
+     * queueSocketEvents()
+     * \param queue: event queue, this function has to be its only consumer
+     */
+    void dispatch(SocketEventQueue& queue)
+    {
+        SocketEvent event;
+        while(queue.pop(event))
+            notify(1 << event.socket);
+    }
+    
+    /**
+     * Retries the operations waiting on notified sockets, resuming the
+     * coroutines whose operation completed
+     * \return number of coroutines resumed
+     */
+    unsigned int poll()
+    {
+        unsigned int resumed = 0;
+        uint8_t mask = pending.exchange(0u);
+        
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            Operation *op = waiting[s];
+            if(op == 0 || (mask & (1 << s)) == 0)
+                continue;
+            
+            if(!op->attempt())
+                continue;
+            
+            /* the coroutine may wait again on the same socket */
+            waiting[s] = 0;
+            op->handle.resume();
+            resumed++;
+        }
+        
+        return resumed;
+    }
+    
+    /**
+     * \return true if some coroutine is waiting on a socket
+     */
+    bool busy() const
+    {
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            if(waiting[s])
+                return true;
+        }
+        
+        return false;
+    }
+
+private:
+
+    AsyncExecutor(const AsyncExecutor&);
+    AsyncExecutor& operator=(const AsyncExecutor&);
+    
+    void park(int fd, Operation *op) { waiting[fd] = op; }
+    
+    SocketLayer<Chip>& layer;
+    Operation *waiting[Chip::socketCount];  //operation waiting on each socket
+    std::atomic<uint8_t> pending;           //sockets notified since last poll
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // ASYNC_SOCKET_H
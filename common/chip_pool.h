@@ -0,0 +1,321 @@
+/*
+ * Socket manager spreading connections over several chips
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef CHIP_POOL_H
+#define CHIP_POOL_H
+
+#include <stdint.h>
+#include "lock_policy.h"
+
+/**
+ * Presents the sockets of several chips as a single socket namespace.
+ * A socket handle is chip index times Chip::socketCount plus socket number.
+ * 
+ * New connections are placed on the chip having the most free sockets and,
+ * among those, the least data queued in its buffers, as measured by the
+ * last call to service(). Chips are grouped by the SPI bus they are
+ * attached to: service() works on one bus at a time, so that running it
+ * from one thread per bus lets chips on separate buses progress in parallel.
+ * The chip driver's header has to be included before this one.
+ * \param Chip: driver class, W5100, W5200 or W5500
+ * \param MAX_CHIPS: maximum number of chips managed
+ */
+template<class Chip, unsigned int MAX_CHIPS>
+class ChipPool
+{
+public:
+    
+    typedef typename Chip::PollInfo PollInfo;
+    
+    /**
+     * Function called by service() for each allocated socket having
+     * received data or interrupt flags set
+     * \param handle: socket handle
+     * \param info: socket's readiness information
+     * \param arg: user defined argument
+     */
+    typedef void (*EventHandler)(int handle, const PollInfo& info, void *arg);
+    
+    ChipPool() : numChips(0) { }
+    
+    /**
+     * Adds a chip to the pool
+     * \param chip: chip's driver instance
+     * \param bus: identifier of the SPI bus the chip is attached to
+     * \return chip's index, or -1 if the pool is full
+     */
+    int addChip(Chip& chip, uint8_t bus)
+    {
+        LockGuard<DriverMutex> lock(poolMutex);
+        
+        if(numChips == MAX_CHIPS)
+            return -1;
+        
+        ChipState& state = chips[numChips];
+        state.chip = &chip;
+        state.bus = bus;
+        state.allocated = 0;
+        state.closed = ~0u;
+        state.queued = 0;
+        
+        return numChips++;
+    }
+    
+    /**
+     * Reserves a closed socket on the least loaded chip
+     * \return socket handle, or -1 if no socket is available
+     */
+    int allocate()
+    {
+        LockGuard<DriverMutex> lock(poolMutex);
+        
+        int best;
+        
+        while((best = leastLoaded()) >= 0)
+        {
+            ChipState& state = chips[best];
+            
+            for(SOCKET s = 0; s < Chip::socketCount; s++)
+            {
+                unsigned int bit = 1u << s;
+                if((state.allocated & bit) || !(state.closed & bit))
+                    continue;
+                
+                /* closed flags may be stale, check the socket is really free */
+                if(state.chip->getSocketStatusReg(s) != SOCK_CLOSED)
+                {
+                    state.closed &= ~bit;
+                    continue;
+                }
+                
+                state.allocated |= bit;
+                return best * Chip::socketCount + s;
+            }
+            
+            /* all the chip's flags were stale and have been cleared, so
+               the next round picks another chip */
+        }
+        
+        return -1;
+    }
+    
+    /**
+     * Gives back a socket allocated with allocate(), the socket should
+     * have been closed by the application
+     * \param handle: socket handle
+     */
+    void release(int handle)
+    {
+        LockGuard<DriverMutex> lock(poolMutex);
+        
+        ChipState& state = chips[handle / Chip::socketCount];
+        unsigned int bit = 1u << (handle % Chip::socketCount);
+        state.allocated &= ~bit;
+        state.closed |= bit;
+    }
+    
+    /**
+     * \param handle: socket handle
+     * \return driver of the chip owning the socket
+     */
+    Chip& chip(int handle) { return *chips[handle / Chip::socketCount].chip; }
+    
+    /**
+     * \param handle: socket handle
+     * \return socket number on its chip
+     */
+    SOCKET socket(int handle) { return handle % Chip::socketCount; }
+    
+    /**
+     * Polls the allocated sockets of all the chips attached to a bus,
+     * updating the load figures used by allocate() and calling the handler
+     * for the sockets that need attention. Meant to be called by the thread
+     * serving the bus
+     * \param bus: bus identifier
+     * \param handler: function called for each ready socket, may be null
+     * \param arg: argument passed to the handler
+     * \return number of ready sockets
+     */
+    unsigned int service(uint8_t bus, EventHandler handler, void *arg)
+    {
+        unsigned int ready = 0;
+        
+        for(unsigned int i = 0; i < numChips; i++)
+        {
+            if(chips[i].bus == bus)
+                ready += serviceChip(i, handler, arg);
+        }
+        
+        return ready;
+    }
+    
+    /**
+     * Polls all the chips in the pool, for single threaded applications.
+     * Chips are visited alternating buses, so that a transport performing
+     * transfers in background, like DMA does, can keep all buses busy
+     * \param handler: function called for each ready socket, may be null
+     * \param arg: argument passed to the handler
+     * \return number of ready sockets
+     */
+    unsigned int service(EventHandler handler, void *arg)
+    {
+        unsigned int ready = 0;
+        bool visited[MAX_CHIPS] = { false };
+        unsigned int remaining = numChips;
+        
+        while(remaining > 0)
+        {
+            /* one chip per bus each round */
+            int lastBus = -1;
+            
+            for(unsigned int i = 0; i < numChips; i++)
+            {
+                if(visited[i] || chips[i].bus == lastBus)
+                    continue;
+                
+                ready += serviceChip(i, handler, arg);
+                visited[i] = true;
+                lastBus = chips[i].bus;
+                remaining--;
+            }
+        }
+        
+        return ready;
+    }
+    
+private:
+    
+    ChipPool(const ChipPool&);
+    ChipPool& operator=(const ChipPool&);
+    
+    struct ChipState
+    {
+        Chip *chip;
+        uint8_t bus;                //SPI bus identifier
+        unsigned int allocated;     //bitmask of sockets handed out
+        unsigned int closed;        //bitmask of sockets found closed
+        uint32_t queued;            //bytes queued in RX and TX buffers
+    };
+    
+    /* index of the chip a new connection goes to, -1 if none is free */
+    int leastLoaded() const
+    {
+        int best = -1;
+        unsigned int bestFree = 0;
+        
+        for(unsigned int i = 0; i < numChips; i++)
+        {
+            unsigned int free = freeSockets(chips[i]);
+            if(free == 0)
+                continue;
+            
+            if(best < 0 || free > bestFree ||
+               (free == bestFree && chips[i].queued < chips[best].queued))
+            {
+                best = i;
+                bestFree = free;
+            }
+        }
+        
+        return best;
+    }
+    
+    static unsigned int freeSockets(const ChipState& state)
+    {
+        unsigned int free = 0;
+        
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            unsigned int bit = 1u << s;
+            if(!(state.allocated & bit) && (state.closed & bit))
+                free++;
+        }
+        
+        return free;
+    }
+    
+    unsigned int serviceChip(unsigned int index, EventHandler handler, void *arg)
+    {
+        ChipState& state = chips[index];
+        PollInfo info[Chip::socketCount];
+        
+        unsigned int allocated;
+        unsigned int stale;
+        {
+            LockGuard<DriverMutex> lock(poolMutex);
+            allocated = state.allocated;
+            stale = ~(state.allocated | state.closed);
+        }
+        
+        /* only the allocated sockets are polled, as polling clears their
+           interrupt flags. Free sockets are closed unless allocate() found
+           them stale, for those the status register is enough */
+        uint8_t ready = state.chip->pollSockets(allocated, info);
+        
+        uint32_t queued = 0;
+        unsigned int closed = 0;
+        unsigned int count = 0;
+        
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            unsigned int bit = 1u << s;
+            
+            if(stale & bit)
+            {
+                if(state.chip->getSocketStatusReg(s) == SOCK_CLOSED)
+                    closed |= bit;
+                
+                continue;
+            }
+            
+            if(!(allocated & bit))
+                continue;
+            
+            if(info[s].status == SOCK_CLOSED)
+                closed |= bit;
+            
+            queued += info[s].rxSize;
+            queued += state.chip->getTxBufSize(s) - info[s].txFree;
+            
+            if(ready & bit)
+            {
+                if(handler)
+                    handler(index * Chip::socketCount + s, info[s], arg);
+                
+                count++;
+            }
+        }
+        
+        LockGuard<DriverMutex> lock(poolMutex);
+        
+        /* sockets not checked, or released meanwhile, keep their flag */
+        unsigned int keep = ~(allocated | stale) | (allocated & ~state.allocated);
+        state.closed = (state.closed & keep) | (closed & ~keep);
+        state.queued = queued;
+        
+        return count;
+    }
+    
+    ChipState chips[MAX_CHIPS];
+    unsigned int numChips;
+    DriverMutex poolMutex;          //protects allocation state
+};
+
+#endif // CHIP_POOL_H
@@ -0,0 +1,578 @@
+/*
+ * DHCP client with cached lease
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef DHCP_CLIENT_H
+#define DHCP_CLIENT_H
+
+#include <stdint.h>
+#include <string.h>
+#include "socket_api.h"
+
+const uint16_t DHCP_SERVER_PORT = 67;
+const uint16_t DHCP_CLIENT_PORT = 68;
+
+/* messages are built and parsed in a buffer of the minimum size every
+   host has to accept, and sent padded to the BOOTP minimum */
+const uint16_t DHCP_MESSAGE_SIZE = 548;
+const uint16_t DHCP_MIN_MESSAGE  = 300;
+
+/**
+ * Client state
+ */
+enum DhcpState
+{
+    DHCP_STOPPED = 0,       //not started
+    DHCP_SELECTING,         //DISCOVER sent, waiting for an offer
+    DHCP_REQUESTING,        //offer taken, REQUEST sent
+    DHCP_REBOOTING,         //cached lease in use, REQUEST sent to confirm it
+    DHCP_BOUND,             //lease confirmed
+    DHCP_RENEWING,          //lease being renewed with the server that gave it
+    DHCP_REBINDING          //lease being renewed with any server
+};
+
+/**
+ * Lease, as passed to the storage hooks. It is stored as it is, a changed
+ * layout shows as a lease given to a different MAC address
+ */
+struct DhcpLease
+{
+    uint8_t mac[6];         //client MAC address the lease was given to
+    uint8_t ip[4];          //leased IP address
+    uint8_t subnet[4];      //subnet mask
+    uint8_t gateway[4];     //first router
+    uint8_t dns[4];         //first DNS server
+    uint8_t server[4];      //DHCP server identifier
+    uint32_t leaseTime;     //lease duration in seconds, 0xFFFFFFFF if infinite
+    uint32_t renewTime;     //T1, seconds from lease start to renewal
+    uint32_t rebindTime;    //T2, seconds from lease start to rebinding
+};
+
+/**
+ * Function loading the last lease from non volatile storage
+ * \param lease: filled with the stored lease
+ * \param arg: user defined argument
+ * \return false if no lease is stored
+ */
+typedef bool (*DhcpLoadHook)(DhcpLease& lease, void *arg);
+
+/**
+ * Function saving a new lease to non volatile storage
+ * \param lease: lease to be stored
+ * \param arg: user defined argument
+ */
+typedef void (*DhcpStoreHook)(const DhcpLease& lease, void *arg);
+
+/**
+ * DHCP client running on a UDP socket of the socket layer. The last lease
+ * is persisted through the storage hooks so that, on the next start, it is
+ * applied to the chip right away and only confirmed with the server by a
+ * REQUEST (RFC 2131 INIT-REBOOT) in the background, instead of waiting for
+ * a whole DISCOVER, OFFER, REQUEST, ACK exchange. A NAK drops the cached
+ * lease and starts a DISCOVER; while no server answers the cached lease
+ * stays in use and the REQUEST is retransmitted.
+ *
+ * The client never blocks: poll() has to be called periodically, every
+ * few hundred milliseconds, with a millisecond clock, and drives message
+ * retransmissions, lease renewal and rebinding. Lease times are counted on
+ * that clock, longer than about 24 days are shortened to that.
+ * One object serves one chip and is not thread safe.
+ * The chip driver's header has to be included before this one.
+ * \param Chip: driver class
+ */
+template<class Chip>
+class DhcpClient
+{
+public:
+
+    /**
+     * \param sockets: socket layer of the chip, a UDP socket is taken from
+     * it by start()
+     * \param chip: driver of the chip, whose addresses are configured
+     * \param mac: chip's MAC address
+     */
+    DhcpClient(SocketLayer<Chip>& sockets, Chip& chip, const uint8_t *mac) :
+        sockets(sockets), chip(chip), load(0), store(0), hookArg(0), fd(-1),
+        current(DHCP_STOPPED), xid(0), deadline(0), leaseStart(0), retries(0)
+    {
+        memcpy(hwAddr, mac, 6);
+        memset(&leased, 0, sizeof(leased));
+        memset(offered, 0, sizeof(offered));
+        memset(offerServer, 0, sizeof(offerServer));
+        
+        for(int i = 0; i < 6; i++)
+            xid = (xid << 5) ^ (xid >> 27) ^ mac[i];
+    }
+    
+    /**
+     * Sets the functions persisting the lease, to be called before start()
+     * \param loadHook: function loading the stored lease, may be null
+     * \param storeHook: function storing a new lease, may be null
+     * \param arg: argument passed to the hooks
+     */
+    void setStorageHooks(DhcpLoadHook loadHook, DhcpStoreHook storeHook, void *arg)
+    {
+        load = loadHook;
+        store = storeHook;
+        hookArg = arg;
+    }
+    
+    /**
+     * Opens the client's socket and starts the client: a stored lease given
+     * to this MAC address is applied to the chip and confirmed with a
+     * REQUEST, otherwise a DISCOVER is sent
+     * \param now: current time in milliseconds
+     * \return 1 if a stored lease has been applied, in which case the
+     * network can be used right away, 0 if an address has to be obtained
+     * first, or error code of the socket layer
+     */
+    int start(uint32_t now)
+    {
+        if(fd < 0)
+        {
+            int s = sockets.socket(SOCKn_MR_UDP);
+            if(s < 0)
+                return s;
+            
+            sockets.setNonBlocking(s, true);
+            int result = sockets.bind(s, DHCP_CLIENT_PORT);
+            if(result < 0)
+            {
+                sockets.close(s);
+                return result;
+            }
+            
+            fd = s;
+        }
+        
+        if(load && load(leased, hookArg) && memcmp(leased.mac, hwAddr, 6) == 0 &&
+           !zero(leased.ip))
+        {
+            apply();
+            begin(DHCP_REBOOTING, now);
+            return 1;
+        }
+        
+        discover(now);
+        return 0;
+    }
+    
+    /**
+     * Closes the client's socket, the chip keeps its addresses
+     */
+    void stop()
+    {
+        if(fd >= 0)
+            sockets.close(fd);
+        
+        fd = -1;
+        current = DHCP_STOPPED;
+    }
+    
+    /**
+     * Processes the replies received and sends the messages due
+     * \param now: current time in milliseconds
+     * \return client state
+     */
+    DhcpState poll(uint32_t now)
+    {
+        if(current == DHCP_STOPPED)
+            return current;
+        
+        int n;
+        while((n = sockets.recvfrom(fd, msg, sizeof(msg), 0, 0)) > 0)
+            receive(n, now);
+        
+        /* lease times are counted from the ACK, the cached lease in use
+           while rebooting has no known start and does not expire */
+        if(current == DHCP_BOUND || current == DHCP_RENEWING || current == DHCP_REBINDING)
+        {
+            uint32_t elapsed = now - leaseStart;
+            
+            if(leased.leaseTime != 0xFFFFFFFF && elapsed >= ms(leased.leaseTime))
+            {
+                discover(now);
+                return current;
+            }
+            
+            if(current != DHCP_REBINDING && elapsed >= ms(leased.rebindTime))
+                begin(DHCP_REBINDING, now);
+            else if(current == DHCP_BOUND && elapsed >= ms(leased.renewTime))
+                begin(DHCP_RENEWING, now);
+        }
+        
+        if(current != DHCP_BOUND && static_cast<int32_t>(now - deadline) >= 0)
+            retransmit(now);
+        
+        return current;
+    }
+    
+    /**
+     * \return client state
+     */
+    DhcpState state() const { return current; }
+    
+    /**
+     * \return true if the chip has an address, confirmed or cached
+     */
+    bool bound() const { return current >= DHCP_REBOOTING; }
+    
+    /**
+     * \return lease in use, valid when bound() is true
+     */
+    const DhcpLease& lease() const { return leased; }
+
+private:
+
+    DhcpClient(const DhcpClient&);
+    DhcpClient& operator=(const DhcpClient&);
+    
+    /* message types */
+    static const uint8_t DISCOVER = 1;
+    static const uint8_t OFFER    = 2;
+    static const uint8_t REQUEST  = 3;
+    static const uint8_t ACK      = 5;
+    static const uint8_t NAK      = 6;
+    
+    /* retransmission timeouts, in milliseconds */
+    static const uint32_t FIRST_TIMEOUT = 4000;
+    static const uint32_t MAX_TIMEOUT   = 64000;
+    static const uint32_t RENEW_TIMEOUT = 60000;
+    static const uint8_t REQUEST_RETRIES = 4;  //REQUEST retries before a new DISCOVER
+    
+    /* offsets of the fixed fields */
+    static const uint16_t XID    = 4;
+    static const uint16_t FLAGS  = 10;
+    static const uint16_t CIADDR = 12;
+    static const uint16_t YIADDR = 16;
+    static const uint16_t CHADDR = 28;
+    static const uint16_t COOKIE = 236;
+    static const uint16_t OPTIONS = 240;
+    
+    /**
+     * Options of a received message
+     */
+    struct Reply
+    {
+        uint8_t type;
+        uint8_t server[4];
+        uint8_t subnet[4];
+        uint8_t gateway[4];
+        uint8_t dns[4];
+        uint32_t leaseTime;
+        uint32_t renewTime;
+        uint32_t rebindTime;
+    };
+    
+    static bool zero(const uint8_t *ip)
+    {
+        return (ip[0] | ip[1] | ip[2] | ip[3]) == 0;
+    }
+    
+    static uint32_t get32(const uint8_t *p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (p[2] << 8) | p[3];
+    }
+    
+    /* seconds to milliseconds, saturated to stay comparable on the clock */
+    static uint32_t ms(uint32_t seconds)
+    {
+        return seconds < 0x7FFFFFFF / 1000 ? seconds * 1000 : 0x7FFFFFFF;
+    }
+    
+    /* configures the chip with the lease in use */
+    void apply()
+    {
+        chip.setIpAddress(leased.ip);
+        chip.setSubnetMask(leased.subnet);
+        chip.setGatewayAddress(leased.gateway);
+    }
+    
+    /* drops the address and starts over */
+    void discover(uint32_t now)
+    {
+        uint8_t none[4] = {0, 0, 0, 0};
+        chip.setIpAddress(none);
+        memset(leased.ip, 0, 4);
+        begin(DHCP_SELECTING, now);
+    }
+    
+    /* enters a state that sends messages and sends the first one */
+    void begin(DhcpState state, uint32_t now)
+    {
+        current = state;
+        retries = 0;
+        xid = xid * 1103515245UL + 12345 + now;
+        deadline = now;
+        retransmit(now);
+    }
+    
+    void retransmit(uint32_t now)
+    {
+        if(current == DHCP_REQUESTING && retries >= REQUEST_RETRIES)
+        {
+            discover(now);
+            return;
+        }
+        
+        static const uint8_t broadcast[4] = {255, 255, 255, 255};
+        uint16_t len;
+        
+        switch(current)
+        {
+            case DHCP_SELECTING:
+                len = build(DISCOVER, true, 0, 0, 0);
+                break;
+            
+            case DHCP_REQUESTING:
+                len = build(REQUEST, true, 0, offered, offerServer);
+                break;
+            
+            case DHCP_REBOOTING:
+                len = build(REQUEST, true, 0, leased.ip, 0);
+                break;
+            
+            case DHCP_RENEWING:
+            case DHCP_REBINDING:
+                len = build(REQUEST, false, leased.ip, 0, 0);
+                break;
+            
+            default:
+                return;
+        }
+        
+        const uint8_t *dest = current == DHCP_RENEWING ? leased.server : broadcast;
+        
+        /* a send refused because the previous one is still in progress
+           is retried on the next poll */
+        if(sockets.sendto(fd, msg, len, dest, DHCP_SERVER_PORT) < 0)
+            return;
+        
+        /* renewal is retried at a fixed pace until rebinding or expiry,
+           the other exchanges back off exponentially */
+        uint32_t timeout = RENEW_TIMEOUT;
+        if(current != DHCP_RENEWING && current != DHCP_REBINDING)
+        {
+            timeout = FIRST_TIMEOUT << (retries < 4 ? retries : 4);
+            if(timeout > MAX_TIMEOUT)
+                timeout = MAX_TIMEOUT;
+        }
+        
+        deadline = now + timeout;
+        retries++;
+    }
+    
+    /**
+     * Builds a message in msg
+     * \param type: message type
+     * \param broadcastReply: true to ask the server to broadcast the reply,
+     * needed while the chip has no address or an unconfirmed one
+     * \param ciaddr: client address, when renewing, or null
+     * \param requested: requested address option, or null
+     * \param server: server identifier option, or null
+     * \return message length
+     */
+    uint16_t build(uint8_t type, bool broadcastReply, const uint8_t *ciaddr,
+                   const uint8_t *requested, const uint8_t *server)
+    {
+        memset(msg, 0, DHCP_MIN_MESSAGE);
+        msg[0] = 1;                         //BOOTREQUEST
+        msg[1] = 1;                         //ethernet
+        msg[2] = 6;                         //hardware address length
+        msg[XID] = xid >> 24;
+        msg[XID + 1] = xid >> 16;
+        msg[XID + 2] = xid >> 8;
+        msg[XID + 3] = xid;
+        
+        if(broadcastReply)
+            msg[FLAGS] = 0x80;
+        
+        if(ciaddr)
+            memcpy(msg + CIADDR, ciaddr, 4);
+        
+        memcpy(msg + CHADDR, hwAddr, 6);
+        
+        static const uint8_t cookie[4] = {99, 130, 83, 99};
+        memcpy(msg + COOKIE, cookie, 4);
+        
+        uint8_t *p = msg + OPTIONS;
+        *p++ = 53; *p++ = 1; *p++ = type;
+        
+        /* client identifier, hardware type and MAC address */
+        *p++ = 61; *p++ = 7; *p++ = 1;
+        memcpy(p, hwAddr, 6);
+        p += 6;
+        
+        if(requested)
+        {
+            *p++ = 50; *p++ = 4;
+            memcpy(p, requested, 4);
+            p += 4;
+        }
+        
+        if(server)
+        {
+            *p++ = 54; *p++ = 4;
+            memcpy(p, server, 4);
+            p += 4;
+        }
+        
+        /* subnet mask, router, DNS, lease time, T1, T2 */
+        static const uint8_t params[] = {55, 6, 1, 3, 6, 51, 58, 59};
+        memcpy(p, params, sizeof(params));
+        p += sizeof(params);
+        *p++ = 255;
+        
+        uint16_t len = p - msg;
+        return len < DHCP_MIN_MESSAGE ? DHCP_MIN_MESSAGE : len;
+    }
+    
+    /**
+     * Parses the options of a received message
+     * \return false if the message is not a reply to the current exchange
+     */
+    bool parse(uint16_t len, Reply& reply)
+    {
+        static const uint8_t cookie[4] = {99, 130, 83, 99};
+        
+        if(len < OPTIONS || msg[0] != 2 || get32(msg + XID) != xid ||
+           memcmp(msg + CHADDR, hwAddr, 6) != 0 || memcmp(msg + COOKIE, cookie, 4) != 0)
+            return false;
+        
+        memset(&reply, 0, sizeof(reply));
+        reply.leaseTime = 0xFFFFFFFF;
+        
+        for(uint16_t i = OPTIONS; i < len; )
+        {
+            uint8_t code = msg[i];
+            if(code == 255)
+                break;
+            
+            if(code == 0)
+            {
+                i++;
+                continue;
+            }
+            
+            if(i + 2 > len || i + 2 + msg[i + 1] > len)
+                break;
+            
+            uint8_t size = msg[i + 1];
+            const uint8_t *value = msg + i + 2;
+            
+            switch(code)
+            {
+                case 53: if(size >= 1) reply.type = value[0]; break;
+                case 54: if(size >= 4) memcpy(reply.server, value, 4); break;
+                case 1:  if(size >= 4) memcpy(reply.subnet, value, 4); break;
+                case 3:  if(size >= 4) memcpy(reply.gateway, value, 4); break;
+                case 6:  if(size >= 4) memcpy(reply.dns, value, 4); break;
+                case 51: if(size >= 4) reply.leaseTime = get32(value); break;
+                case 58: if(size >= 4) reply.renewTime = get32(value); break;
+                case 59: if(size >= 4) reply.rebindTime = get32(value); break;
+            }
+            
+            i += 2 + size;
+        }
+        
+        return reply.type != 0;
+    }
+    
+    void receive(uint16_t len, uint32_t now)
+    {
+        Reply reply;
+        if(!parse(len, reply))
+            return;
+        
+        if(current == DHCP_SELECTING)
+        {
+            if(reply.type != OFFER || zero(reply.server))
+                return;
+            
+            /* the first offer is taken */
+            memcpy(offered, msg + YIADDR, 4);
+            memcpy(offerServer, reply.server, 4);
+            current = DHCP_REQUESTING;
+            retries = 0;
+            retransmit(now);
+            return;
+        }
+        
+        if(current == DHCP_REQUESTING && memcmp(reply.server, offerServer, 4) != 0)
+            return;
+        
+        if(reply.type == NAK && current != DHCP_BOUND)
+        {
+            discover(now);
+            return;
+        }
+        
+        if(reply.type == ACK && current != DHCP_BOUND)
+            bind(reply, now);
+    }
+    
+    void bind(const Reply& reply, uint32_t now)
+    {
+        DhcpLease lease;
+        memset(&lease, 0, sizeof(lease));
+        memcpy(lease.mac, hwAddr, 6);
+        memcpy(lease.ip, msg + YIADDR, 4);
+        memcpy(lease.subnet, reply.subnet, 4);
+        memcpy(lease.gateway, reply.gateway, 4);
+        memcpy(lease.dns, reply.dns, 4);
+        memcpy(lease.server, zero(reply.server) ? leased.server : reply.server, 4);
+        lease.leaseTime = reply.leaseTime;
+        lease.renewTime = reply.renewTime ? reply.renewTime : reply.leaseTime / 2;
+        lease.rebindTime = reply.rebindTime ? reply.rebindTime :
+                           reply.leaseTime - reply.leaseTime / 8;
+        
+        /* the chip is reconfigured, and the lease stored, only when it
+           changed, which spares the storage the writes of every renewal */
+        if(memcmp(&lease, &leased, sizeof(lease)) != 0)
+        {
+            leased = lease;
+            apply();
+            if(store)
+                store(leased, hookArg);
+        }
+        
+        current = DHCP_BOUND;
+        leaseStart = now;
+    }
+    
+    SocketLayer<Chip>& sockets;
+    Chip& chip;
+    DhcpLoadHook load;
+    DhcpStoreHook store;
+    void *hookArg;                  //argument of the storage hooks
+    int fd;                         //client's socket, -1 if not open
+    DhcpState current;
+    uint32_t xid;                   //transaction identifier
+    uint32_t deadline;              //time of next retransmission
+    uint32_t leaseStart;            //time the lease was confirmed
+    uint8_t retries;                //messages sent in current exchange
+    uint8_t hwAddr[6];
+    uint8_t offered[4];             //address offered, while requesting
+    uint8_t offerServer[4];         //server of the offer taken
+    DhcpLease leased;               //lease in use
+    uint8_t msg[DHCP_MESSAGE_SIZE]; //message being built or parsed
+};
+
+#endif // DHCP_CLIENT_H
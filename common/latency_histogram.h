@@ -0,0 +1,311 @@
+/*
+ * Latency histograms kept by the drivers
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include "w5x00_defs.h"
+
+/*
+ * Histograms are compiled in only when W5X00_LATENCY_HISTOGRAMS is defined,
+ * otherwise the driver uses an empty class with the same interface, whose
+ * calls compile to nothing.
+ */
+
+/**
+ * Function returning the current time, in ticks of any unit, used to
+ * timestamp driver operations, for example a cycle counter read
+ */
+typedef uint32_t (*TimestampHook)();
+
+/**
+ * Latencies measured by the driver
+ */
+enum LatencyMetric
+{
+    LATENCY_RECV = 0,       //RECV interrupt seen to readData() done
+    LATENCY_SEND,           //SEND command to SEND_OK interrupt seen
+    LATENCY_CONNECT,        //CONNECT command to connection established
+    LATENCY_SPI_FRAME,      //SPI frame duration, averaged over each access
+    LATENCY_METRICS
+};
+
+/**
+ * Function called by exportLatencyHistograms() for each non empty bucket
+ * \param metric: latency the bucket belongs to
+ * \param low: lowest value counted in the bucket
+ * \param high: highest value counted in the bucket
+ * \param count: number of samples in the bucket
+ * \param arg: user defined argument
+ */
+typedef void (*LatencyExportHook)(LatencyMetric metric, uint32_t low,
+                                  uint32_t high, uint32_t count, void *arg);
+
+/**
+ * Fixed memory log-linear histogram of 32 bit values: values below
+ * 2^SUB_BITS have a bucket each, larger values are grouped by power of two
+ * and each group is split into 2^SUB_BITS buckets, so the relative error
+ * is bounded by 2^-SUB_BITS over the whole range
+ * \param SUB_BITS: base 2 logarithm of the buckets per power of two
+ */
+template<unsigned int SUB_BITS>
+class LogLinearHistogram
+{
+public:
+
+    static const unsigned int SUB_BUCKETS = 1 << SUB_BITS;
+    static const unsigned int BUCKETS = (33 - SUB_BITS) * SUB_BUCKETS;
+    
+    LogLinearHistogram() { reset(); }
+    
+    /**
+     * Adds a sample
+     */
+    void record(uint32_t value)
+    {
+        counts[bucketOf(value)]++;
+        samples++;
+        if(value > maxValue)
+            maxValue = value;
+    }
+    
+    /**
+     * \return the value below which lies the given fraction of samples,
+     * as the upper bound of the bucket reaching it
+     * \param perMille: fraction of samples in thousandths, 500 for the median
+     */
+    uint32_t percentile(unsigned int perMille) const
+    {
+        uint64_t target = (static_cast<uint64_t>(samples) * perMille + 999) / 1000;
+        uint64_t seen = 0;
+        
+        for(unsigned int b = 0; b < BUCKETS; b++)
+        {
+            seen += counts[b];
+            if(seen >= target && seen > 0)
+                return highOf(b) < maxValue ? highOf(b) : maxValue;
+        }
+        
+        return maxValue;
+    }
+    
+    uint32_t count() const { return samples; }
+    uint32_t max() const { return maxValue; }
+    uint32_t bucketCount(unsigned int b) const { return counts[b]; }
+    
+    void reset()
+    {
+        memset(counts, 0, sizeof(counts));
+        samples = 0;
+        maxValue = 0;
+    }
+    
+    static unsigned int bucketOf(uint32_t value)
+    {
+        if(value < SUB_BUCKETS)
+            return value;
+        
+        unsigned int msb = 31;
+        while((value & (1UL << msb)) == 0)
+            msb--;
+        
+        unsigned int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+    }
+    
+    static uint32_t lowOf(unsigned int b)
+    {
+        if(b < SUB_BUCKETS)
+            return b;
+        
+        unsigned int shift = b / SUB_BUCKETS - 1;
+        return static_cast<uint32_t>(SUB_BUCKETS + b % SUB_BUCKETS) << shift;
+    }
+    
+    static uint32_t highOf(unsigned int b)
+    {
+        return b + 1 < BUCKETS ? lowOf(b + 1) - 1 : 0xFFFFFFFF;
+    }
+
+private:
+    uint32_t counts[BUCKETS];
+    uint32_t samples;
+    uint32_t maxValue;
+};
+
+/**
+ * Histogram used by the drivers, 4 buckets per power of two
+ * (25% resolution) in 496 bytes
+ */
+typedef LogLinearHistogram<2> LatencyHistogram;
+
+#if defined(W5X00_LATENCY_HISTOGRAMS)
+
+/**
+ * Latency histograms of a chip, and the timestamps of the operations in
+ * progress on its sockets. Nothing is recorded until a timestamp hook is
+ * set. Updates are done under the lock held by the measured operation,
+ * those done by queueSocketEvents() from interrupt context may race with
+ * the others and lose a sample
+ * \param N: number of sockets
+ */
+template<unsigned char N>
+class LatencyStats
+{
+public:
+    LatencyStats() : now(0)
+    {
+        memset(started, 0, sizeof(started));
+    }
+    
+    void setHook(TimestampHook hook)
+    {
+        now = hook;
+        memset(started, 0, sizeof(started));
+    }
+    
+    uint32_t start() const { return now ? now() : 0; }
+    
+    void frames(uint32_t since, uint16_t count)
+    {
+        if(now)
+            histograms[LATENCY_SPI_FRAME].record((now() - since) / count);
+    }
+    
+    void command(uint8_t s, uint8_t value)
+    {
+        if(!now)
+            return;
+        
+        if(value == SOCKn_CR_SEND)
+            begin(s, LATENCY_SEND);
+        else if(value == SOCKn_CR_CONNECT)
+            begin(s, LATENCY_CONNECT);
+    }
+    
+    void flags(uint8_t s, uint8_t value)
+    {
+        if(!now)
+            return;
+        
+        if((value & SOCKn_IR_RECV) && !started[s][LATENCY_RECV].active)
+            begin(s, LATENCY_RECV);
+        
+        if(value & SOCKn_IR_SEND_OK)
+            end(s, LATENCY_SEND);
+        
+        if(value & SOCKn_IR_CON)
+            end(s, LATENCY_CONNECT);
+        
+        if(value & SOCKn_IR_TIMEOUT)
+        {
+            started[s][LATENCY_SEND].active = false;
+            started[s][LATENCY_CONNECT].active = false;
+        }
+    }
+    
+    void status(uint8_t s, uint8_t value)
+    {
+        if(value == SOCK_ESTABLISHED)
+            end(s, LATENCY_CONNECT);
+        else if(value == SOCK_CLOSED)
+            started[s][LATENCY_CONNECT].active = false;
+    }
+    
+    void delivered(uint8_t s) { end(s, LATENCY_RECV); }
+    
+    const LatencyHistogram *histogram(LatencyMetric metric) const
+    {
+        return &histograms[metric];
+    }
+    
+    void exportTo(LatencyExportHook hook, void *arg) const
+    {
+        for(unsigned int m = 0; m < LATENCY_METRICS; m++)
+        {
+            for(unsigned int b = 0; b < LatencyHistogram::BUCKETS; b++)
+            {
+                uint32_t count = histograms[m].bucketCount(b);
+                if(count != 0)
+                    hook(static_cast<LatencyMetric>(m), LatencyHistogram::lowOf(b),
+                         LatencyHistogram::highOf(b), count, arg);
+            }
+        }
+    }
+    
+    void reset()
+    {
+        for(unsigned int m = 0; m < LATENCY_METRICS; m++)
+            histograms[m].reset();
+    }
+
+private:
+    void begin(uint8_t s, LatencyMetric metric)
+    {
+        started[s][metric].time = now();
+        started[s][metric].active = true;
+    }
+    
+    void end(uint8_t s, LatencyMetric metric)
+    {
+        if(!now || !started[s][metric].active)
+            return;
+        
+        histograms[metric].record(now() - started[s][metric].time);
+        started[s][metric].active = false;
+    }
+    
+    struct Start
+    {
+        uint32_t time;
+        bool active;
+    };
+    
+    TimestampHook now;
+    Start started[N][LATENCY_SPI_FRAME];    //per socket operations in progress
+    LatencyHistogram histograms[LATENCY_METRICS];
+};
+
+#else // W5X00_LATENCY_HISTOGRAMS
+
+/**
+ * Histograms compiled out
+ */
+template<unsigned char N>
+class LatencyStats
+{
+public:
+    void setHook(TimestampHook) { }
+    uint32_t start() const { return 0; }
+    void frames(uint32_t, uint16_t) { }
+    void command(uint8_t, uint8_t) { }
+    void flags(uint8_t, uint8_t) { }
+    void status(uint8_t, uint8_t) { }
+    void delivered(uint8_t) { }
+    const LatencyHistogram *histogram(LatencyMetric) const { return 0; }
+    void exportTo(LatencyExportHook, void *) const { }
+    void reset() { }
+};
+
+#endif // W5X00_LATENCY_HISTOGRAMS
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,110 @@
+/*
+ * Locking policies used by the drivers to protect chip access
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef LOCK_POLICY_H
+#define LOCK_POLICY_H
+
+/*
+ * The lock type used by the drivers is chosen at build time:
+ * - define W5X00_LOCK_STD_MUTEX to use std::mutex
+ * - define W5X00_LOCK_RTOS to use RtosMutex, whose member functions have to
+ *   be implemented in rtos_mutex.cpp on top of the target's RTOS primitives
+ * - otherwise no locking is performed, which is the right choice for single
+ *   threaded applications
+ */
+
+#if defined(W5X00_LOCK_STD_MUTEX)
+#include <mutex>
+#endif
+
+/**
+ * Lock doing nothing, used when the driver is accessed by one thread only
+ */
+class NoLock
+{
+public:
+    void lock() { }
+    void unlock() { }
+};
+
+/**
+ * Mutex provided by the target's RTOS, a non recursive one is enough
+ */
+class RtosMutex
+{
+public:
+    RtosMutex();
+    ~RtosMutex();
+    
+    void lock();
+    void unlock();
+    
+private:
+    RtosMutex(const RtosMutex&);
+    RtosMutex& operator=(const RtosMutex&);
+    
+    void *handle;   //RTOS mutex object
+};
+
+#if defined(W5X00_LOCK_STD_MUTEX)
+typedef std::mutex DriverMutex;
+#elif defined(W5X00_LOCK_RTOS)
+typedef RtosMutex DriverMutex;
+#else
+typedef NoLock DriverMutex;
+#endif
+
+/**
+ * Scoped lock, acquires the mutex on construction and releases it
+ * on destruction
+ */
+template<class M>
+class LockGuard
+{
+public:
+    explicit LockGuard(M& mutex) : m(mutex) { m.lock(); }
+    ~LockGuard() { m.unlock(); }
+    
+private:
+    LockGuard(const LockGuard&);
+    LockGuard& operator=(const LockGuard&);
+    
+    M& m;
+};
+
+/**
+ * Gives the lock shared by all the chips on a transport policy's physical
+ * bus, which the policy may provide as DriverMutex *busLock(). Null if it
+ * does not, or returns null, in which case the chip has the bus to itself
+ */
+template<class T>
+class BusLockOf
+{
+    template<class U>
+    static DriverMutex *get(U& t, decltype(&U::busLock)) { return t.busLock(); }
+    
+    template<class U>
+    static DriverMutex *get(U&, ...) { return 0; }
+    
+public:
+    static DriverMutex *of(T& transport) { return get<T>(transport, 0); }
+};
+
+#endif // LOCK_POLICY_H
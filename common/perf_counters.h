@@ -0,0 +1,165 @@
+/*
+ * Performance counters kept by the drivers
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "w5x00_defs.h"
+
+/*
+ * Counters are compiled in only when W5X00_PERF_COUNTERS is defined,
+ * otherwise the driver uses an empty class with the same interface, whose
+ * calls compile to nothing.
+ */
+
+/**
+ * SPI operation types frames and bytes are counted by
+ */
+enum SpiOperation
+{
+    SPI_REG_READ = 0,       //register read
+    SPI_REG_WRITE,          //register write
+    SPI_BUF_READ,           //copy from a socket's RX buffer
+    SPI_BUF_WRITE,          //copy to a socket's TX buffer
+    SPI_OPERATIONS
+};
+
+/**
+ * Counters of a chip, as returned by getPerfCounters()
+ */
+struct ChipCounters
+{
+    uint32_t frames[SPI_OPERATIONS];    //SPI frames by operation type
+    uint32_t bytes[SPI_OPERATIONS];     //data bytes by operation type
+};
+
+/**
+ * Counters of a socket, as returned by getPerfCounters()
+ */
+struct SocketCounters
+{
+    uint32_t readCalls;     //readData() calls
+    uint32_t readBytes;     //bytes read by readData()
+    uint32_t writeCalls;    //writeData() calls
+    uint32_t writeBytes;    //bytes written by writeData()
+    uint32_t rxWraps;       //readData() copies crossing the end of the ring
+    uint32_t txWraps;       //writeData() copies crossing the end of the ring
+    uint32_t commands;      //commands issued
+    uint32_t commandPolls;  //command register reads waiting for completion
+    uint32_t sendOk;        //SEND_OK interrupts cleared by the driver
+    uint32_t timeouts;      //TIMEOUT interrupts cleared by the driver
+    uint16_t rxHighWater;   //highest received size seen by getReceivedSize()
+};
+
+#if defined(W5X00_PERF_COUNTERS)
+
+/**
+ * Counters of a chip and of its sockets. Updates are plain increments done
+ * under the lock already held by the counted operation, so a snapshot taken
+ * while other threads use the driver may be off by the operations in
+ * progress
+ * \param N: number of sockets
+ */
+template<unsigned char N>
+class PerfCounters
+{
+public:
+    PerfCounters() { reset(); }
+    
+    void transfer(SpiOperation op, uint16_t frames, uint16_t bytes)
+    {
+        chip.frames[op] += frames;
+        chip.bytes[op] += bytes;
+    }
+    
+    void read(uint8_t s, uint16_t len, bool wrap)
+    {
+        sockets[s].readCalls++;
+        sockets[s].readBytes += len;
+        if(wrap) sockets[s].rxWraps++;
+    }
+    
+    void write(uint8_t s, uint16_t len, bool wrap)
+    {
+        sockets[s].writeCalls++;
+        sockets[s].writeBytes += len;
+        if(wrap) sockets[s].txWraps++;
+    }
+    
+    void command(uint8_t s) { sockets[s].commands++; }
+    
+    void commandWait(uint8_t s, uint16_t polls) { sockets[s].commandPolls += polls; }
+    
+    void interrupts(uint8_t s, uint8_t flags)
+    {
+        if(flags & SOCKn_IR_SEND_OK) sockets[s].sendOk++;
+        if(flags & SOCKn_IR_TIMEOUT) sockets[s].timeouts++;
+    }
+    
+    void received(uint8_t s, uint16_t size)
+    {
+        if(size > sockets[s].rxHighWater) sockets[s].rxHighWater = size;
+    }
+    
+    bool snapshot(ChipCounters& chipCounters, SocketCounters *sockCounters) const
+    {
+        chipCounters = chip;
+        if(sockCounters)
+            memcpy(sockCounters, sockets, sizeof(sockets));
+        
+        return true;
+    }
+    
+    void reset()
+    {
+        memset(&chip, 0, sizeof(chip));
+        memset(sockets, 0, sizeof(sockets));
+    }
+
+private:
+    ChipCounters chip;
+    SocketCounters sockets[N];
+};
+
+#else // W5X00_PERF_COUNTERS
+
+/**
+ * Counters compiled out
+ */
+template<unsigned char N>
+class PerfCounters
+{
+public:
+    void transfer(SpiOperation, uint16_t, uint16_t) { }
+    void read(uint8_t, uint16_t, bool) { }
+    void write(uint8_t, uint16_t, bool) { }
+    void command(uint8_t) { }
+    void commandWait(uint8_t, uint16_t) { }
+    void interrupts(uint8_t, uint8_t) { }
+    void received(uint8_t, uint16_t) { }
+    bool snapshot(ChipCounters&, SocketCounters *) const { return false; }
+    void reset() { }
+};
+
+#endif // W5X00_PERF_COUNTERS
+
+#endif // PERF_COUNTERS_H
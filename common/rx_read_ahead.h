@@ -0,0 +1,191 @@
+/*
+ * Host side RX read-ahead cache serving small socket reads
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef RX_READ_AHEAD_H
+#define RX_READ_AHEAD_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Mirrors the received data of a socket in host memory, so that parsers
+ * reading a line or a field at a time do not pay the register accesses of
+ * a readData() and a RECV command for every few bytes.
+ *
+ * Each refill moves everything the chip has received, up to the free space
+ * in the host buffer, with a single burst and then frees the chip's buffer
+ * with a single RECV command. Reads are served from host memory and refill
+ * the cache only when it runs empty.
+ *
+ * Meant for stream sockets: on datagram sockets the chip's packet headers
+ * are cached as well and have to be parsed by the caller.
+ * One object serves one socket and is not thread safe.
+ * The chip driver's header has to be included before this one.
+ * \param Chip: driver class
+ * \param SIZE: host buffer size in bytes
+ */
+template<class Chip, uint16_t SIZE>
+class RxReadAhead
+{
+public:
+
+    /**
+     * \param chip: driver of the chip the socket belongs to
+     * \param sockNum: socket number
+     */
+    RxReadAhead(Chip& chip, SOCKET sockNum) : chip(chip), sockNum(sockNum),
+        head(0), count(0), recvPending(false) { }
+    
+    /**
+     * Moves the data received by the chip to the host buffer, as much as
+     * fits, with one burst and one RECV command. If the command could not
+     * be issued it is retried by the next call, which moves no new data
+     * until it succeeds
+     * \return number of bytes added to the cache
+     */
+    uint16_t fill()
+    {
+        /* received size is not updated until the chip gets RECV */
+        if(recvPending)
+        {
+            if(!chip.issueSocketCommand(sockNum, SOCKn_CR_RECV))
+                return 0;
+            
+            recvPending = false;
+        }
+        
+        if(count == SIZE)
+            return 0;
+        
+        if(head != 0)
+        {
+            memmove(buffer, buffer + head, count);
+            head = 0;
+        }
+        
+        uint16_t n = chip.getReceivedSize(sockNum);
+        if(n > SIZE - count)
+            n = SIZE - count;
+        
+        if(n == 0)
+            return 0;
+        
+        chip.readData(sockNum, buffer + count, n);
+        recvPending = !chip.issueSocketCommand(sockNum, SOCKn_CR_RECV);
+        count += n;
+        return n;
+    }
+    
+    /**
+     * Reads from the cache, refilling it once if it is empty
+     * \param data: destination buffer
+     * \param len: maximum number of bytes
+     * \return number of bytes read, 0 if nothing was received
+     */
+    uint16_t read(uint8_t *data, uint16_t len)
+    {
+        if(count == 0)
+            fill();
+        
+        uint16_t n = peek(data, len);
+        skip(n);
+        return n;
+    }
+    
+    /**
+     * Copies cached data without consuming it, does not refill the cache
+     * \param data: destination buffer
+     * \param len: maximum number of bytes
+     * \return number of bytes copied
+     */
+    uint16_t peek(uint8_t *data, uint16_t len) const
+    {
+        if(len > count)
+            len = count;
+        
+        memcpy(data, buffer + head, len);
+        return len;
+    }
+    
+    /**
+     * Looks for a byte in the cache, for example a line terminator,
+     * refilling it when the byte is not found and there is room left
+     * \param value: byte to be searched
+     * \return offset of the byte from the first cached one, -1 if not found
+     */
+    int find(uint8_t value)
+    {
+        uint16_t from = 0;
+        
+        for(;;)
+        {
+            const void *p = memchr(buffer + head + from, value, count - from);
+            if(p)
+                return static_cast<const uint8_t *>(p) - (buffer + head);
+            
+            from = count;
+            if(fill() == 0)
+                return -1;
+        }
+    }
+    
+    /**
+     * Consumes cached data
+     * \param len: number of bytes, at most available()
+     */
+    void skip(uint16_t len)
+    {
+        if(len > count)
+            len = count;
+        
+        head += len;
+        count -= len;
+        if(count == 0)
+            head = 0;
+    }
+    
+    /**
+     * \return number of bytes in the cache
+     */
+    uint16_t available() const { return count; }
+    
+    /**
+     * Drops cached data, for example when the connection is closed
+     */
+    void discard()
+    {
+        head = count = 0;
+        recvPending = false;
+    }
+
+private:
+
+    RxReadAhead(const RxReadAhead&);
+    RxReadAhead& operator=(const RxReadAhead&);
+    
+    Chip& chip;
+    SOCKET sockNum;
+    uint16_t head;                  //offset of the first cached byte
+    uint16_t count;                 //bytes in cache
+    bool recvPending;               //RECV for data already cached not issued
+    uint8_t buffer[SIZE];
+};
+
+#endif // RX_READ_AHEAD_H
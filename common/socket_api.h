@@ -0,0 +1,600 @@
+/*
+ * BSD-style socket layer built on top of the W5x00 drivers
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef SOCKET_API_H
+#define SOCKET_API_H
+
+#include <stdint.h>
+#include "lock_policy.h"
+
+/* error codes returned by the socket layer, always negative */
+const int SOCKERR_NOSOCKET     = -1;    //no free socket
+const int SOCKERR_BADF         = -2;    //descriptor not valid or not open
+const int SOCKERR_INVAL        = -3;    //operation not valid for socket's type or state
+const int SOCKERR_WOULDBLOCK   = -4;    //non blocking socket, operation would block
+const int SOCKERR_INPROGRESS   = -5;    //non blocking connection in progress
+const int SOCKERR_NOTCONN      = -6;    //socket not connected
+const int SOCKERR_CONNRESET    = -7;    //connection closed by peer or dropped
+const int SOCKERR_TIMEDOUT     = -8;    //ARP or TCP timeout
+const int SOCKERR_BUSY         = -9;    //chip did not accept a socket command
+
+/* first local port assigned to sockets not bound explicitly */
+const uint16_t EPHEMERAL_PORT_BASE = 49152;
+
+/**
+ * Socket interface in the style of BSD sockets for a chip driver: sockets
+ * are allocated and tracked by the layer and identified by a descriptor,
+ * functions return a non negative value on success and an error code
+ * otherwise. Sockets are blocking unless set otherwise with setNonBlocking(),
+ * blocking calls poll the chip calling the wait hook between two polls.
+ *
+ * Chip commands are issued without waiting for their completion, which is
+ * checked when the socket is next accessed, and data is moved with the
+ * driver's burst transfers.
+ *
+ * On W5x00 chips a listening socket becomes the accepted connection, so
+ * accept() returns the listening descriptor itself: to serve further
+ * clients a new listening socket has to be opened.
+ * The chip driver's header has to be included before this one.
+ * \param Chip: driver class
+ */
+template<class Chip>
+class SocketLayer
+{
+public:
+
+    /**
+     * Function called between two polls of a blocking call, can be used
+     * to yield the CPU to other tasks
+     * \param attempt: number of polls already done
+     */
+    typedef void (*WaitHook)(uint16_t attempt);
+    
+    /**
+     * \param chip: driver of the chip the sockets belong to
+     */
+    explicit SocketLayer(Chip& chip) : chip(chip), waitHook(0),
+        nextPort(EPHEMERAL_PORT_BASE)
+    {
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+            state[s].used = false;
+    }
+    
+    /**
+     * Sets the function called while blocking calls wait
+     */
+    void setWaitHook(WaitHook hook) { waitHook = hook; }
+    
+    /**
+     * Allocates a socket
+     * \param type: SOCKn_MR_TCP or SOCKn_MR_UDP
+     * \param flags: additional mode register flags, like SOCKn_MR_ND
+     * \return socket descriptor or error code
+     */
+    int socket(uint8_t type, uint8_t flags = 0)
+    {
+        if(type != SOCKn_MR_TCP && type != SOCKn_MR_UDP)
+            return SOCKERR_INVAL;
+        
+        LockGuard<DriverMutex> lock(allocMutex);
+        
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            if(state[s].used)
+                continue;
+            
+            /* sockets closed gracefully may still be shutting down */
+            if(chip.getSocketStatusReg(s) != SOCK_CLOSED)
+                continue;
+            
+            SocketState& st = state[s];
+            st.used = true;
+            st.mode = type | flags;
+            st.nonBlocking = false;
+            st.opened = false;
+            st.sendPending = false;
+            st.port = 0;
+            return s;
+        }
+        
+        return SOCKERR_NOSOCKET;
+    }
+    
+    /**
+     * Switches socket between blocking and non blocking mode
+     * \param fd: socket descriptor
+     * \param nonBlocking: true for non blocking mode
+     * \return 0 or error code
+     */
+    int setNonBlocking(int fd, bool nonBlocking)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        state[fd].nonBlocking = nonBlocking;
+        return 0;
+    }
+    
+    /**
+     * Assigns the local port, UDP sockets are opened and start receiving
+     * \param fd: socket descriptor
+     * \param port: local port number
+     * \return 0 or error code
+     */
+    int bind(int fd, uint16_t port)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(state[fd].opened || port == 0)
+            return SOCKERR_INVAL;
+        
+        state[fd].port = port;
+        
+        if(isUdp(fd))
+            return open(fd);
+        
+        return 0;
+    }
+    
+    /**
+     * Puts a bound TCP socket in listening state
+     * \param fd: socket descriptor
+     * \return 0 or error code
+     */
+    int listen(int fd)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(isUdp(fd) || state[fd].opened || state[fd].port == 0)
+            return SOCKERR_INVAL;
+        
+        int result = open(fd);
+        if(result < 0)
+            return result;
+        
+        return command(fd, SOCKn_CR_LISTEN);
+    }
+    
+    /**
+     * Waits for a client to connect to a listening socket
+     * \param fd: socket descriptor
+     * \return the same descriptor once connected, or error code
+     */
+    int accept(int fd)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(isUdp(fd) || !state[fd].opened)
+            return SOCKERR_INVAL;
+        
+        for(uint16_t attempt = 0; ; attempt++)
+        {
+            uint8_t status = chip.getSocketStatusReg(fd);
+            
+            if(status == SOCK_ESTABLISHED || status == SOCK_CLOSE_WAIT)
+                return fd;
+            
+            if(status != SOCK_LISTEN && status != SOCK_SYNRECV)
+                return SOCKERR_CONNRESET;
+            
+            if(state[fd].nonBlocking)
+                return SOCKERR_WOULDBLOCK;
+            
+            wait(attempt);
+        }
+    }
+    
+    /**
+     * Connects a TCP socket to a remote host, non blocking sockets return
+     * SOCKERR_INPROGRESS until the connection is established
+     * \param fd: socket descriptor
+     * \param ip: remote IP address
+     * \param port: remote port
+     * \return 0 or error code
+     */
+    int connect(int fd, const uint8_t *ip, uint16_t port)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(isUdp(fd))
+            return SOCKERR_INVAL;
+        
+        if(!state[fd].opened)
+        {
+            int result = open(fd);
+            if(result < 0)
+                return result;
+            
+            uint8_t addr[4] = { ip[0], ip[1], ip[2], ip[3] };
+            chip.setSocketDestIp(fd, addr);
+            chip.setSocketDestPort(fd, port);
+            
+            result = command(fd, SOCKn_CR_CONNECT);
+            if(result < 0)
+                return result;
+        }
+        
+        for(uint16_t attempt = 0; ; attempt++)
+        {
+            uint8_t status = chip.getSocketStatusReg(fd);
+            
+            if(status == SOCK_ESTABLISHED)
+                return 0;
+            
+            if(status == SOCK_CLOSED)
+            {
+                state[fd].opened = false;
+                return SOCKERR_TIMEDOUT;
+            }
+            
+            /* status may not have left INIT yet right after CONNECT */
+            if(status != SOCK_SYNSENT && status != SOCK_INIT)
+                return SOCKERR_INVAL;
+            
+            if(state[fd].nonBlocking)
+                return SOCKERR_INPROGRESS;
+            
+            wait(attempt);
+        }
+    }
+    
+    /**
+     * Queues data for transmission on a connected TCP socket, as much as
+     * fits in socket's TX buffer
+     * \param fd: socket descriptor
+     * \param data: data to be sent
+     * \param len: number of bytes to be sent
+     * \return number of bytes queued or error code
+     */
+    int send(int fd, const uint8_t *data, uint16_t len)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(isUdp(fd))
+            return SOCKERR_INVAL;
+        
+        for(uint16_t attempt = 0; ; attempt++)
+        {
+            uint8_t status = chip.getSocketStatusReg(fd);
+            
+            if(status != SOCK_ESTABLISHED && status != SOCK_CLOSE_WAIT)
+                return status == SOCK_CLOSED ? SOCKERR_CONNRESET : SOCKERR_NOTCONN;
+            
+            int result = sendCompleted(fd);
+            if(result < 0)
+                return result;
+            
+            uint16_t free = chip.getTxFreeSize(fd);
+            
+            if(result > 0 && free > 0)
+            {
+                uint16_t n = len < free ? len : free;
+                return transmit(fd, data, n);
+            }
+            
+            if(state[fd].nonBlocking)
+                return SOCKERR_WOULDBLOCK;
+            
+            wait(attempt);
+        }
+    }
+    
+    /**
+     * Reads data received on a TCP socket
+     * \param fd: socket descriptor
+     * \param data: buffer for received data
+     * \param len: buffer size
+     * \return number of bytes read, 0 if the peer closed the connection and
+     * all its data has been read, or error code
+     */
+    int recv(int fd, uint8_t *data, uint16_t len)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(isUdp(fd))
+            return SOCKERR_INVAL;
+        
+        for(uint16_t attempt = 0; ; attempt++)
+        {
+            uint16_t size = chip.getReceivedSize(fd);
+            
+            if(size > 0)
+            {
+                uint16_t n = len < size ? len : size;
+                chip.readData(fd, data, n);
+                
+                int result = command(fd, SOCKn_CR_RECV);
+                return result < 0 ? result : n;
+            }
+            
+            uint8_t status = chip.getSocketStatusReg(fd);
+            
+            if(status == SOCK_CLOSE_WAIT || status == SOCK_CLOSED)
+                return 0;
+            
+            if(status != SOCK_ESTABLISHED)
+                return SOCKERR_NOTCONN;
+            
+            if(state[fd].nonBlocking)
+                return SOCKERR_WOULDBLOCK;
+            
+            wait(attempt);
+        }
+    }
+    
+    /**
+     * Sends a datagram on a UDP socket, which is opened on an ephemeral
+     * port if not bound
+     * \param fd: socket descriptor
+     * \param data: datagram payload
+     * \param len: payload size, must fit in socket's TX buffer
+     * \param ip: destination IP address
+     * \param port: destination port
+     * \return number of bytes sent or error code
+     */
+    int sendto(int fd, const uint8_t *data, uint16_t len, const uint8_t *ip, uint16_t port)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(!isUdp(fd) || len > chip.getTxBufSize(fd))
+            return SOCKERR_INVAL;
+        
+        if(!state[fd].opened)
+        {
+            int result = open(fd);
+            if(result < 0)
+                return result;
+        }
+        
+        for(uint16_t attempt = 0; ; attempt++)
+        {
+            int result = sendCompleted(fd);
+            if(result < 0)
+                return result;
+            
+            if(result > 0 && chip.getTxFreeSize(fd) >= len)
+                break;
+            
+            if(state[fd].nonBlocking)
+                return SOCKERR_WOULDBLOCK;
+            
+            wait(attempt);
+        }
+        
+        uint8_t addr[4] = { ip[0], ip[1], ip[2], ip[3] };
+        chip.setSocketDestIp(fd, addr);
+        chip.setSocketDestPort(fd, port);
+        
+        return transmit(fd, data, len);
+    }
+    
+    /**
+     * Receives a datagram on a bound UDP socket, the part of the datagram
+     * not fitting in the buffer is discarded
+     * \param fd: socket descriptor
+     * \param data: buffer for datagram payload
+     * \param len: buffer size
+     * \param ip: if not null, filled with source IP address
+     * \param port: if not null, filled with source port
+     * \return number of bytes read or error code
+     */
+    int recvfrom(int fd, uint8_t *data, uint16_t len, uint8_t *ip, uint16_t *port)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        if(!isUdp(fd) || !state[fd].opened)
+            return SOCKERR_INVAL;
+        
+        for(uint16_t attempt = 0; chip.getReceivedSize(fd) == 0; attempt++)
+        {
+            if(state[fd].nonBlocking)
+                return SOCKERR_WOULDBLOCK;
+            
+            wait(attempt);
+        }
+        
+        /* each datagram is preceded by source address, port and size */
+        uint8_t header[8];
+        chip.readData(fd, header, sizeof(header));
+        
+        if(ip)
+        {
+            for(int i = 0; i < 4; i++)
+                ip[i] = header[i];
+        }
+        
+        if(port)
+            *port = (header[4] << 8) | header[5];
+        
+        uint16_t size = (header[6] << 8) | header[7];
+        uint16_t n = len < size ? len : size;
+        chip.readData(fd, data, n);
+        
+        /* drop the rest of the datagram */
+        chip.skipData(fd, size - n);
+        
+        int result = command(fd, SOCKn_CR_RECV);
+        return result < 0 ? result : n;
+    }
+    
+    /**
+     * \param fd: socket descriptor
+     * \return socket's status register value, or error code
+     */
+    int status(int fd)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        return chip.getSocketStatusReg(fd);
+    }
+    
+    /**
+     * Closes the socket and frees its descriptor. Connected TCP sockets are
+     * disconnected gracefully and become available again once the chip
+     * completes the disconnection
+     * \param fd: socket descriptor
+     * \return 0 or error code
+     */
+    int close(int fd)
+    {
+        if(!valid(fd))
+            return SOCKERR_BADF;
+        
+        uint8_t status = chip.getSocketStatusReg(fd);
+        bool connected = status == SOCK_ESTABLISHED || status == SOCK_CLOSE_WAIT;
+        
+        int result = command(fd, connected ? SOCKn_CR_DISCON : SOCKn_CR_CLOSE);
+        
+        LockGuard<DriverMutex> lock(allocMutex);
+        state[fd].used = false;
+        return result < 0 ? result : 0;
+    }
+
+private:
+
+    SocketLayer(const SocketLayer&);
+    SocketLayer& operator=(const SocketLayer&);
+    
+    struct SocketState
+    {
+        bool used;                  //descriptor allocated
+        bool opened;                //OPEN command issued
+        bool nonBlocking;           //calls return instead of waiting
+        bool sendPending;           //SEND issued, completion not seen yet
+        uint8_t mode;               //socket's mode register value
+        uint16_t port;              //local port, 0 if not assigned
+    };
+    
+    bool valid(int fd) const
+    {
+        return fd >= 0 && fd < Chip::socketCount && state[fd].used;
+    }
+    
+    bool isUdp(int fd) const
+    {
+        return (state[fd].mode & 0x0F) == SOCKn_MR_UDP;
+    }
+    
+    void wait(uint16_t attempt)
+    {
+        if(waitHook)
+            waitHook(attempt);
+    }
+    
+    int command(int fd, uint8_t cmd)
+    {
+        return chip.issueSocketCommand(fd, cmd) ? 0 : SOCKERR_BUSY;
+    }
+    
+    /* configures mode and local port and opens the socket */
+    int open(int fd)
+    {
+        SocketState& st = state[fd];
+        
+        if(st.port == 0)
+        {
+            LockGuard<DriverMutex> lock(allocMutex);
+            st.port = nextPort++;
+            if(nextPort == 0)
+                nextPort = EPHEMERAL_PORT_BASE;
+        }
+        
+        chip.setSocketModeReg(fd, st.mode);
+        chip.setSocketSourcePort(fd, st.port);
+        
+        int result = command(fd, SOCKn_CR_OPEN);
+        if(result < 0)
+            return result;
+        
+        /* status read waits for OPEN completion */
+        uint8_t expected = isUdp(fd) ? SOCK_UDP : SOCK_INIT;
+        if(chip.getSocketStatusReg(fd) != expected)
+        {
+            command(fd, SOCKn_CR_CLOSE);
+            return SOCKERR_BUSY;
+        }
+        
+        st.opened = true;
+        return 0;
+    }
+    
+    /**
+     * Checks whether the last SEND has completed, the chip must not be
+     * given a new SEND before. The SEND_OK flag may have been consumed by
+     * an interrupt handler, so an empty TX buffer is taken as completion too
+     * \return 1 if completed, 0 if not yet, error code if it failed
+     */
+    int sendCompleted(int fd)
+    {
+        if(!state[fd].sendPending)
+            return 1;
+        
+        uint8_t flags = chip.getSocketInterruptReg(fd);
+        
+        if(flags & SOCKn_IR_TIMEOUT)
+        {
+            chip.clearSocketInterruptFlags(fd, SOCKn_IR_TIMEOUT);
+            state[fd].sendPending = false;
+            return SOCKERR_TIMEDOUT;
+        }
+        
+        if((flags & SOCKn_IR_SEND_OK) ||
+           chip.getTxFreeSize(fd) == chip.getTxBufSize(fd))
+        {
+            if(flags & SOCKn_IR_SEND_OK)
+                chip.clearSocketInterruptFlags(fd, SOCKn_IR_SEND_OK);
+            
+            state[fd].sendPending = false;
+            return 1;
+        }
+        
+        return 0;
+    }
+    
+    /* copies data to the TX buffer and issues SEND without waiting */
+    int transmit(int fd, const uint8_t *data, uint16_t len)
+    {
+        chip.writeData(fd, data, len);
+        
+        int result = command(fd, SOCKn_CR_SEND);
+        if(result < 0)
+            return result;
+        
+        state[fd].sendPending = true;
+        return len;
+    }
+    
+    Chip& chip;
+    WaitHook waitHook;
+    SocketState state[Chip::socketCount];
+    uint16_t nextPort;              //next ephemeral port
+    DriverMutex allocMutex;         //protects descriptors allocation
+};
+
+#endif // SOCKET_API_H
@@ -0,0 +1,361 @@
+/*
+ * Deficit round robin scheduler sharing SPI bus time among sockets
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef SOCKET_SCHEDULER_H
+#define SOCKET_SCHEDULER_H
+
+#include <stdint.h>
+
+/**
+ * Splits large socket transfers in bounded chunks and interleaves them,
+ * so that a bulk transfer on a socket cannot hold the bus while another
+ * socket has latency sensitive traffic.
+ *
+ * Transfers are queued with write() and read(), one per direction and
+ * socket, and carried out by run(), which makes one deficit round robin
+ * round over the sockets: each socket with a transfer in progress gets its
+ * quantum of bytes added to a deficit counter and may move as many bytes
+ * as the counter holds. Quanta therefore act as weights on the share of
+ * bus time, and a socket waiting for a round is delayed at most by the
+ * quanta of the sockets served before it. Sockets with higher priority are
+ * served first in each round.
+ *
+ * Every chunk written is followed by a SEND command, the next one is
+ * written once the chip has sent the previous one; every chunk read is
+ * followed by a RECV command. A chunk whose command could not be issued
+ * stays pending, and the command is retried by the next round before
+ * anything else is moved on that socket.
+ *
+ * The scheduler has to be the only user of the sockets it transfers on
+ * and run() has to be called from a single thread.
+ * The chip driver's header has to be included before this one.
+ * \param Chip: driver class
+ */
+template<class Chip>
+class SocketScheduler
+{
+public:
+
+    static const uint16_t DEFAULT_QUANTUM = 256;  //bytes per round
+    
+    /**
+     * \param chip: driver of the chip whose sockets are scheduled
+     */
+    explicit SocketScheduler(Chip& chip) : chip(chip)
+    {
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            quantum[s] = DEFAULT_QUANTUM;
+            priority[s] = 0;
+            deficit[s] = 0;
+            order[s] = s;
+            cancel(s);
+        }
+    }
+    
+    /**
+     * \param sockNum: socket number
+     * \param bytes: bytes the socket may move in each round, its weight
+     */
+    void setQuantum(SOCKET sockNum, uint16_t bytes)
+    {
+        quantum[sockNum] = bytes > 0 ? bytes : 1;
+    }
+    
+    /**
+     * \param sockNum: socket number
+     * \param level: sockets with higher level are served first in each round
+     */
+    void setPriority(SOCKET sockNum, uint8_t level)
+    {
+        priority[sockNum] = level;
+        
+        /* stable insertion sort, equal levels keep socket order */
+        for(SOCKET i = 0; i < Chip::socketCount; i++)
+            order[i] = i;
+        
+        for(SOCKET i = 1; i < Chip::socketCount; i++)
+        {
+            SOCKET s = order[i];
+            SOCKET j = i;
+            for(; j > 0 && priority[order[j - 1]] < priority[s]; j--)
+                order[j] = order[j - 1];
+            
+            order[j] = s;
+        }
+    }
+    
+    /**
+     * Queues data to be sent on a socket
+     * \param sockNum: socket number
+     * \param data: data to be sent, has to stay valid until the transfer ends
+     * \param len: number of bytes
+     * \return false if a write is already in progress on the socket,
+     * including the completion of its last SEND
+     */
+    bool write(SOCKET sockNum, const uint8_t *data, uint16_t len)
+    {
+        if(writing(sockNum))
+            return false;
+        
+        txData[sockNum] = data;
+        txLeft[sockNum] = len;
+        errorFlags[sockNum] = 0;
+        return true;
+    }
+    
+    /**
+     * Queues a read of a given amount of data from a socket
+     * \param sockNum: socket number
+     * \param data: destination buffer, has to stay valid until the transfer ends
+     * \param len: number of bytes to be read
+     * \return false if a read is already in progress on the socket
+     */
+    bool read(SOCKET sockNum, uint8_t *data, uint16_t len)
+    {
+        if(rxLeft[sockNum] > 0)
+            return false;
+        
+        rxData[sockNum] = data;
+        rxLeft[sockNum] = len;
+        return true;
+    }
+    
+    /**
+     * \return bytes still to be sent by the write in progress, those of the
+     * last chunk included until the chip has sent them, 0 when done
+     */
+    uint16_t txRemaining(SOCKET sockNum) const
+    {
+        return txLeft[sockNum] + (sendPending[sockNum] ? txInFlight[sockNum] : 0);
+    }
+    
+    /**
+     * \return bytes still to be read by the read in progress, 0 when done
+     */
+    uint16_t rxRemaining(SOCKET sockNum) const { return rxLeft[sockNum]; }
+    
+    /**
+     * \return SOCKn_IR_TIMEOUT if the last write was dropped because the
+     * chip timed out sending it, 0 otherwise
+     */
+    uint8_t errors(SOCKET sockNum) const { return errorFlags[sockNum]; }
+    
+    /**
+     * Drops the transfers in progress on a socket, for example when the
+     * connection is closed
+     */
+    void cancel(SOCKET sockNum)
+    {
+        txLeft[sockNum] = 0;
+        rxLeft[sockNum] = 0;
+        txUnsent[sockNum] = 0;
+        txInFlight[sockNum] = 0;
+        rxUnfreed[sockNum] = 0;
+        sendPending[sockNum] = false;
+        errorFlags[sockNum] = 0;
+    }
+    
+    /**
+     * Makes one round over the sockets with transfers in progress
+     * \return number of bytes moved
+     */
+    uint32_t run()
+    {
+        uint32_t moved = 0;
+        
+        for(SOCKET i = 0; i < Chip::socketCount; i++)
+        {
+            SOCKET s = order[i];
+            if(!writing(s) && rxLeft[s] == 0)
+            {
+                deficit[s] = 0;
+                continue;
+            }
+            
+            deficit[s] += quantum[s];
+            
+            uint16_t n = serviceTx(s);
+            n += serviceRx(s);
+            moved += n;
+            
+            /* credit is dropped once the socket has nothing left to move.
+               A socket blocked by the chip, waiting for a SEND to complete
+               or for data to arrive, keeps at most one quantum: it does not
+               lose its share once unblocked, but cannot save up a burst */
+            if(txLeft[s] == 0 && rxLeft[s] == 0)
+                deficit[s] = 0;
+            else if(n == 0 && deficit[s] > quantum[s])
+                deficit[s] = quantum[s];
+        }
+        
+        return moved;
+    }
+    
+    /**
+     * \return true if some transfer is in progress
+     */
+    bool busy() const
+    {
+        for(SOCKET s = 0; s < Chip::socketCount; s++)
+        {
+            if(writing(s) || rxLeft[s] > 0)
+                return true;
+        }
+        
+        return false;
+    }
+
+private:
+
+    SocketScheduler(const SocketScheduler&);
+    SocketScheduler& operator=(const SocketScheduler&);
+    
+    /* a write lasts until the chip is done with its last chunk, so that a
+       timeout sending it is charged to that write */
+    bool writing(SOCKET s) const { return txLeft[s] > 0 || sendPending[s]; }
+    
+    /* true once the chip is done with the last chunk sent */
+    bool sendCompleted(SOCKET s)
+    {
+        if(!sendPending[s])
+            return true;
+        
+        uint8_t flags = chip.getSocketInterruptReg(s);
+        
+        if(flags & SOCKn_IR_TIMEOUT)
+        {
+            chip.clearSocketInterruptFlags(s, SOCKn_IR_TIMEOUT);
+            sendPending[s] = false;
+            txLeft[s] = 0;
+            txInFlight[s] = 0;
+            errorFlags[s] = SOCKn_IR_TIMEOUT;
+            return false;
+        }
+        
+        if((flags & SOCKn_IR_SEND_OK) == 0 &&
+           chip.getTxFreeSize(s) != chip.getTxBufSize(s))
+            return false;
+        
+        if(flags & SOCKn_IR_SEND_OK)
+            chip.clearSocketInterruptFlags(s, SOCKn_IR_SEND_OK);
+        
+        sendPending[s] = false;
+        txInFlight[s] = 0;
+        return true;
+    }
+    
+    /* writes a chunk within the socket's deficit, checking first the
+       completion of the previous one even if it was the last */
+    uint16_t serviceTx(SOCKET s)
+    {
+        if(!sendCompleted(s) || txLeft[s] == 0)
+            return 0;
+        
+        uint16_t n = txUnsent[s];
+        
+        if(n == 0)
+        {
+            n = chip.getTxFreeSize(s);
+            if(n > txLeft[s])
+                n = txLeft[s];
+            
+            if(n > deficit[s])
+                n = deficit[s];
+            
+            if(n == 0)
+                return 0;
+            
+            chip.writeData(s, txData[s], n);
+            txUnsent[s] = n;
+        }
+        
+        /* the chunk is in the chip's buffer already, if SEND cannot be
+           issued it stays pending until the next round */
+        if(!chip.issueSocketCommand(s, SOCKn_CR_SEND))
+            return 0;
+        
+        sendPending[s] = true;
+        txInFlight[s] = n;
+        txUnsent[s] = 0;
+        
+        txData[s] += n;
+        txLeft[s] -= n;
+        deficit[s] = deficit[s] > n ? deficit[s] - n : 0;
+        return n;
+    }
+    
+    /* reads a chunk within the socket's deficit */
+    uint16_t serviceRx(SOCKET s)
+    {
+        if(rxLeft[s] == 0)
+            return 0;
+        
+        uint16_t n = rxUnfreed[s];
+        
+        if(n == 0)
+        {
+            if(deficit[s] == 0)
+                return 0;
+            
+            n = chip.getReceivedSize(s);
+            if(n > rxLeft[s])
+                n = rxLeft[s];
+            
+            if(n > deficit[s])
+                n = deficit[s];
+            
+            if(n == 0)
+                return 0;
+            
+            chip.readData(s, rxData[s], n);
+            rxUnfreed[s] = n;
+        }
+        
+        /* received size is not updated until the chip gets RECV, so if
+           it cannot be issued the chunk stays pending until next round */
+        if(!chip.issueSocketCommand(s, SOCKn_CR_RECV))
+            return 0;
+        
+        rxUnfreed[s] = 0;
+        
+        rxData[s] += n;
+        rxLeft[s] -= n;
+        deficit[s] = deficit[s] > n ? deficit[s] - n : 0;
+        return n;
+    }
+    
+    Chip& chip;
+    uint16_t quantum[Chip::socketCount];    //bytes added to deficit each round
+    uint8_t priority[Chip::socketCount];
+    uint32_t deficit[Chip::socketCount];    //bytes the socket may still move
+    SOCKET order[Chip::socketCount];        //sockets by decreasing priority
+    const uint8_t *txData[Chip::socketCount];
+    uint16_t txLeft[Chip::socketCount];
+    uint8_t *rxData[Chip::socketCount];
+    uint16_t rxLeft[Chip::socketCount];
+    uint16_t txUnsent[Chip::socketCount];   //chunk written, SEND not issued yet
+    uint16_t txInFlight[Chip::socketCount]; //chunk the chip is sending
+    uint16_t rxUnfreed[Chip::socketCount];  //chunk read, RECV not issued yet
+    bool sendPending[Chip::socketCount];    //last chunk not yet sent by the chip
+    uint8_t errorFlags[Chip::socketCount];
+};
+
+#endif // SOCKET_SCHEDULER_H
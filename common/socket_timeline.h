@@ -0,0 +1,329 @@
+/*
+ * Socket state transition timeline kept by the drivers
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef SOCKET_TIMELINE_H
+#define SOCKET_TIMELINE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "w5x00_defs.h"
+#include "latency_histogram.h"
+
+/*
+ * The timeline is compiled in only when W5X00_SOCKET_TIMELINE is defined,
+ * otherwise the driver uses an empty class with the same interface, whose
+ * calls compile to nothing.
+ *
+ * The chip does not signal status changes, so they are timestamped when the
+ * driver sees them: on getSocketStatusReg() and pollSockets() calls and on
+ * CON, DISCON and TIMEOUT interrupts. Their resolution is the interval the
+ * application polls at.
+ */
+
+const unsigned int SOCKET_TIMELINE_DEPTH = 16;  //entries kept per socket
+
+/**
+ * Kind of timeline entry
+ */
+enum TimelineEntryType
+{
+    TIMELINE_STATUS = 0,    //new status register value seen
+    TIMELINE_COMMAND,       //command issued by the application
+    TIMELINE_INTERRUPT      //CON, DISCON or TIMEOUT interrupt seen
+};
+
+/**
+ * One entry of a socket's timeline
+ */
+struct SocketTransition
+{
+    uint32_t time;          //timestamp
+    uint8_t type;           //TimelineEntryType
+    uint8_t value;          //new status, command or interrupt flags
+    uint8_t status;         //status known before the entry
+    uint8_t reserved;
+};
+
+/* bits of ConnectionTimes::measured */
+const uint8_t CONN_RECONNECT  = 0x01;
+const uint8_t CONN_SETUP      = 0x02;
+const uint8_t CONN_TEARDOWN   = 0x04;
+const uint8_t CONN_PEER_CLOSE = 0x08;
+
+/**
+ * Last connection durations of a socket, in timestamp ticks, as returned by
+ * getConnectionTimes(). Each one is the last measured, measured flags which
+ * have been measured at least once
+ */
+struct ConnectionTimes
+{
+    uint32_t reconnect;     //socket closed to OPEN command issued again
+    uint32_t setup;         //CONNECT command, or SYN received, to established
+    uint32_t teardown;      //DISCON command, or FIN received, to closed or CLOSE
+    uint8_t measured;       //CONN_ bits of the durations measured, CONN_PEER_CLOSE
+                            //if the last teardown was started by the peer
+};
+
+#if defined(W5X00_SOCKET_TIMELINE)
+
+/**
+ * Per socket ring of the last status transitions, commands and connection
+ * interrupts, and durations of connection setup and teardown derived from
+ * them. Nothing is recorded until a timestamp hook is set. Updates are done
+ * under the socket's lock, those done by the interrupt helpers may race
+ * with the others
+ * \param N: number of sockets
+ */
+template<unsigned char N>
+class SocketTimeline
+{
+public:
+    SocketTimeline() : now(0) { reset(); }
+    
+    void setHook(TimestampHook hook)
+    {
+        now = hook;
+        reset();
+    }
+    
+    void command(uint8_t s, uint8_t value)
+    {
+        if(!now)
+            return;
+        
+        Socket& k = sockets[s];
+        uint32_t t = now();
+        
+        switch(value)
+        {
+            case SOCKn_CR_OPEN:
+                if(k.closedSeen)
+                {
+                    k.times.reconnect = t - k.closedAt;
+                    k.times.measured |= CONN_RECONNECT;
+                    k.closedSeen = false;
+                }
+                
+                k.setupActive = false;
+                k.teardownActive = false;
+                break;
+            
+            case SOCKn_CR_CONNECT:
+                k.setupStart = t;
+                k.setupActive = true;
+                break;
+            
+            case SOCKn_CR_DISCON:
+                beginTeardown(k, t, false);
+                break;
+            
+            case SOCKn_CR_CLOSE:
+                /* the socket is closed right away */
+                closed(k, t);
+                break;
+            
+            default:
+                /* data path commands would flush the ring in no time */
+                return;
+        }
+        
+        append(k, t, TIMELINE_COMMAND, value);
+    }
+    
+    void flags(uint8_t s, uint8_t value)
+    {
+        value &= SOCKn_IR_CON | SOCKn_IR_DISCON | SOCKn_IR_TIMEOUT;
+        if(!now || value == 0)
+            return;
+        
+        Socket& k = sockets[s];
+        uint32_t t = now();
+        append(k, t, TIMELINE_INTERRUPT, value);
+        
+        if(value & SOCKn_IR_CON)
+            endSetup(k, t);
+        
+        /* FIN from the peer, or connection reset */
+        if(value & SOCKn_IR_DISCON)
+            beginTeardown(k, t, true);
+    }
+    
+    void status(uint8_t s, uint8_t value)
+    {
+        Socket& k = sockets[s];
+        if(!now || value == k.status)
+            return;
+        
+        uint32_t t = now();
+        append(k, t, TIMELINE_STATUS, value);
+        
+        switch(value)
+        {
+            case SOCK_SYNRECV:
+                if(!k.setupActive)
+                {
+                    k.setupStart = t;
+                    k.setupActive = true;
+                }
+                break;
+            
+            case SOCK_ESTABLISHED:
+                endSetup(k, t);
+                break;
+            
+            case SOCK_FIN_WAIT:
+            case SOCK_CLOSING:
+            case SOCK_TIME_WAIT:
+            case SOCK_LAST_ACK:
+                beginTeardown(k, t, false);
+                break;
+            
+            case SOCK_CLOSE_WAIT:
+                beginTeardown(k, t, true);
+                break;
+            
+            case SOCK_CLOSED:
+                closed(k, t);
+                break;
+        }
+    }
+    
+    uint8_t read(uint8_t s, SocketTransition *out, uint8_t max) const
+    {
+        const Socket& k = sockets[s];
+        uint32_t stored = k.next < SOCKET_TIMELINE_DEPTH ? k.next : SOCKET_TIMELINE_DEPTH;
+        uint32_t count = stored < max ? stored : max;
+        uint32_t first = k.next - count;
+        
+        for(uint32_t i = 0; i < count; i++)
+            out[i] = k.ring[(first + i) % SOCKET_TIMELINE_DEPTH];
+        
+        return count;
+    }
+    
+    bool times(uint8_t s, ConnectionTimes& out) const
+    {
+        out = sockets[s].times;
+        return true;
+    }
+    
+    void reset()
+    {
+        memset(sockets, 0, sizeof(sockets));
+    }
+
+private:
+    struct Socket
+    {
+        SocketTransition ring[SOCKET_TIMELINE_DEPTH];
+        uint32_t next;              //entries written since reset
+        uint32_t setupStart;
+        uint32_t teardownStart;
+        uint32_t closedAt;
+        ConnectionTimes times;
+        uint8_t status;             //last status seen
+        bool setupActive;
+        bool teardownActive;
+        bool closedSeen;
+    };
+    
+    void append(Socket& k, uint32_t t, TimelineEntryType type, uint8_t value)
+    {
+        SocketTransition& e = k.ring[k.next % SOCKET_TIMELINE_DEPTH];
+        e.time = t;
+        e.type = type;
+        e.value = value;
+        e.status = k.status;
+        e.reserved = 0;
+        k.next++;
+        
+        if(type == TIMELINE_STATUS)
+            k.status = value;
+    }
+    
+    void endSetup(Socket& k, uint32_t t)
+    {
+        if(!k.setupActive)
+            return;
+        
+        k.times.setup = t - k.setupStart;
+        k.times.measured |= CONN_SETUP;
+        k.setupActive = false;
+    }
+    
+    void closed(Socket& k, uint32_t t)
+    {
+        if(k.teardownActive)
+        {
+            k.times.teardown = t - k.teardownStart;
+            k.times.measured |= CONN_TEARDOWN;
+            k.teardownActive = false;
+        }
+        
+        /* a connection attempt ending here has failed */
+        k.setupActive = false;
+        
+        /* CLOSE command and closed status may both be seen */
+        if(!k.closedSeen)
+        {
+            k.closedAt = t;
+            k.closedSeen = true;
+        }
+    }
+    
+    void beginTeardown(Socket& k, uint32_t t, bool peer)
+    {
+        /* only the first sign of closing starts the measure */
+        if(k.teardownActive)
+            return;
+        
+        k.teardownStart = t;
+        k.teardownActive = true;
+        if(peer)
+            k.times.measured |= CONN_PEER_CLOSE;
+        else
+            k.times.measured &= ~CONN_PEER_CLOSE;
+    }
+    
+    TimestampHook now;
+    Socket sockets[N];
+};
+
+#else // W5X00_SOCKET_TIMELINE
+
+/**
+ * Timeline compiled out
+ */
+template<unsigned char N>
+class SocketTimeline
+{
+public:
+    void setHook(TimestampHook) { }
+    void command(uint8_t, uint8_t) { }
+    void flags(uint8_t, uint8_t) { }
+    void status(uint8_t, uint8_t) { }
+    uint8_t read(uint8_t, SocketTransition *, uint8_t) const { return 0; }
+    bool times(uint8_t, ConnectionTimes&) const { return false; }
+    void reset() { }
+};
+
+#endif // W5X00_SOCKET_TIMELINE
+
+#endif // SOCKET_TIMELINE_H
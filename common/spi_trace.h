@@ -0,0 +1,164 @@
+/*
+ * SPI transaction trace recorder
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef SPI_TRACE_H
+#define SPI_TRACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "perf_counters.h"
+#include "latency_histogram.h"
+
+/*
+ * The recorder is compiled in only when W5X00_SPI_TRACE is defined,
+ * otherwise the driver uses an empty class with the same interface, whose
+ * calls compile to nothing.
+ *
+ * A trace is saved as a SpiTraceHeader followed by header.count records,
+ * in the host's byte order, which is what tools/spi_trace_decode.cpp and
+ * tools/spi_trace_replay.cpp read.
+ */
+
+const uint8_t SPI_TRACE_VERSION = 1;
+const uint8_t SPI_TRACE_NO_SOCKET = 0xFF;   //access not tied to a socket
+
+/**
+ * One chip access: a register or register group access, or a socket
+ * buffer copy, with the frames it took
+ */
+struct SpiTraceRecord
+{
+    uint32_t time;          //timestamp at start of access
+    uint32_t address;       //chip address, as encoded by the chip's traits
+    uint16_t len;           //bytes transferred
+    uint16_t duration;      //access duration in timestamp ticks, saturated
+    uint8_t op;             //SpiOperation
+    uint8_t socket;         //socket the address belongs to, or SPI_TRACE_NO_SOCKET
+    uint8_t reserved[2];
+};
+
+/**
+ * Header of a saved trace, filled by readSpiTrace()
+ */
+struct SpiTraceHeader
+{
+    char magic[4];          //"W5TR"
+    uint8_t version;        //SPI_TRACE_VERSION
+    uint8_t recordSize;     //sizeof(SpiTraceRecord)
+    uint16_t chip;          //chip model, 5100, 5200 or 5500
+    uint32_t count;         //records following the header
+    uint32_t dropped;       //older records overwritten in the ring
+};
+
+#if defined(W5X00_SPI_TRACE)
+
+/**
+ * Flight recorder of chip accesses, writing to a ring buffer provided by
+ * the application and overwriting the oldest records when full. Recording
+ * is done under the driver's bus lock
+ */
+class SpiTracer
+{
+public:
+    SpiTracer() : ring(0), capacity(0), next(0), clock(0), active(false) { }
+    
+    void start(SpiTraceRecord *buffer, uint32_t size, TimestampHook hook)
+    {
+        ring = buffer;
+        capacity = size;
+        next = 0;
+        clock = hook;
+        active = buffer != 0 && size > 0;
+    }
+    
+    /* records are kept until next start() */
+    void stop() { active = false; }
+    
+    bool enabled() const { return active; }
+    
+    uint32_t begin() const { return active && clock ? clock() : 0; }
+    
+    void record(uint32_t start, SpiOperation op, uint32_t address,
+                uint16_t len, uint8_t socket)
+    {
+        if(!active)
+            return;
+        
+        uint32_t elapsed = clock ? clock() - start : 0;
+        
+        SpiTraceRecord& r = ring[next % capacity];
+        r.time = start;
+        r.address = address;
+        r.len = len;
+        r.duration = elapsed < 0xFFFF ? elapsed : 0xFFFF;
+        r.op = op;
+        r.socket = socket;
+        r.reserved[0] = r.reserved[1] = 0;
+        next++;
+    }
+    
+    uint32_t read(SpiTraceHeader& header, uint16_t chip,
+                  SpiTraceRecord *out, uint32_t max) const
+    {
+        uint32_t stored = next < capacity ? next : capacity;
+        uint32_t first = next - stored;
+        uint32_t count = stored < max ? stored : max;
+        
+        /* oldest records are the ones left out when out is too small */
+        first += stored - count;
+        for(uint32_t i = 0; i < count; i++)
+            out[i] = ring[(first + i) % capacity];
+        
+        memcpy(header.magic, "W5TR", 4);
+        header.version = SPI_TRACE_VERSION;
+        header.recordSize = sizeof(SpiTraceRecord);
+        header.chip = chip;
+        header.count = count;
+        header.dropped = next - count;
+        return count;
+    }
+
+private:
+    SpiTraceRecord *ring;
+    uint32_t capacity;
+    uint32_t next;              //records written since start
+    TimestampHook clock;
+    bool active;
+};
+
+#else // W5X00_SPI_TRACE
+
+/**
+ * Recorder compiled out
+ */
+class SpiTracer
+{
+public:
+    void start(SpiTraceRecord *, uint32_t, TimestampHook) { }
+    void stop() { }
+    bool enabled() const { return false; }
+    uint32_t begin() const { return 0; }
+    void record(uint32_t, SpiOperation, uint32_t, uint16_t, uint8_t) { }
+    uint32_t read(SpiTraceHeader&, uint16_t, SpiTraceRecord *, uint32_t) const { return 0; }
+};
+
+#endif // W5X00_SPI_TRACE
+
+#endif // SPI_TRACE_H
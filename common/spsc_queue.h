@@ -0,0 +1,132 @@
+/*
+ * Bounded single producer, single consumer lock-free queue
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+
+/**
+ * Ring buffer meant to pass items from an interrupt handler to a task
+ * without locks nor disabling interrupts. Only one context may push and
+ * only one context may pop.
+ * \param T: item type, must be copy assignable
+ * \param N: queue capacity, must be a power of two
+ */
+template<typename T, unsigned int N>
+class SpscQueue
+{
+public:
+    
+    static_assert(N != 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+    
+    SpscQueue() : head(0), tail(0), overflows(0) { }
+    
+    /**
+     * Appends an item to the queue, to be called by the producer only
+     * \param item: item to be appended
+     * \return false if the queue is full, in which case the item is dropped
+     */
+    bool push(const T& item)
+    {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        
+        if(h - tail.load(std::memory_order_acquire) == N)
+        {
+            overflows.store(overflows.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+            return false;
+        }
+        
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    
+    /**
+     * Removes the oldest item from the queue, to be called by the consumer only
+     * \param item: where to store the item removed
+     * \return false if the queue is empty
+     */
+    bool pop(T& item)
+    {
+        return popBatch(&item, 1) == 1;
+    }
+    
+    /**
+     * Removes up to max items from the queue in one go, to be called by the
+     * consumer only
+     * \param dst: array where to store the items removed
+     * \param max: maximum number of items to be removed
+     * \return number of items removed
+     */
+    unsigned int popBatch(T *dst, unsigned int max)
+    {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        unsigned int count = head.load(std::memory_order_acquire) - t;
+        
+        if(count > max)
+            count = max;
+        
+        for(unsigned int i = 0; i < count; i++)
+            dst[i] = items[(t + i) & (N - 1)];
+        
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+    
+    /**
+     * \return true if the queue is empty
+     */
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) ==
+               tail.load(std::memory_order_acquire);
+    }
+    
+    /**
+     * \return true if the queue is full, to be called by the producer only
+     * to check there is room before pushing
+     */
+    bool full() const
+    {
+        return head.load(std::memory_order_relaxed) -
+               tail.load(std::memory_order_acquire) == N;
+    }
+    
+    /**
+     * \return number of items dropped because the queue was full
+     */
+    unsigned int droppedCount() const
+    {
+        return overflows.load(std::memory_order_relaxed);
+    }
+    
+private:
+    
+    T items[N];
+    
+    /* free running indexes, wrapping is handled by unsigned arithmetic */
+    std::atomic<unsigned int> head;        //written by producer only
+    std::atomic<unsigned int> tail;        //written by consumer only
+    std::atomic<unsigned int> overflows;   //written by producer only
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,250 @@
+/*
+ * Host side TX buffer coalescing small socket writes
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef TX_COALESCER_H
+#define TX_COALESCER_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Accumulates the small writes to a socket in host memory and moves them
+ * to the chip as a single burst followed by a single SEND command, saving
+ * the pointer register accesses and the TCP segment each write would cost.
+ *
+ * Buffered data is flushed when:
+ * - it reaches the size threshold, for example the socket's MSS
+ * - flush() is called, for example at the end of a request
+ * - the oldest buffered byte has waited longer than the maximum delay,
+ *   checked by poll()
+ * - in Nagle mode, poll() finds the chip's TX buffer empty, that is all
+ *   the data previously sent has been acknowledged
+ * A new SEND is issued only once the previous one has completed, that is
+ * SEND_OK is flagged or the chip's TX buffer has drained, so until then
+ * flushes leave data buffered.
+ *
+ * Time is expressed in ticks of any unit, as long as the same one is used
+ * for maximum delay and for the timestamps passed to write() and poll().
+ * One object serves one socket and is not thread safe.
+ * The chip driver's header has to be included before this one.
+ * \param Chip: driver class
+ * \param SIZE: host buffer size in bytes
+ */
+template<class Chip, uint16_t SIZE>
+class TxCoalescer
+{
+public:
+
+    /**
+     * \param chip: driver of the chip the socket belongs to
+     * \param sockNum: socket number
+     * \param threshold: buffered bytes triggering a flush, at most SIZE
+     * \param maxDelay: maximum time data is held, 0 for no limit
+     */
+    TxCoalescer(Chip& chip, SOCKET sockNum, uint16_t threshold = SIZE,
+                uint32_t maxDelay = 0) : chip(chip), sockNum(sockNum),
+        threshold(threshold < SIZE ? threshold : SIZE), maxDelay(maxDelay),
+        nagle(false), inFlight(false), unsent(false), count(0), since(0),
+        newest(0), newestAt(0) { }
+    
+    /**
+     * Enables Nagle mode, in which buffered data is flushed by poll() as
+     * soon as nothing is left in flight
+     */
+    void setNagle(bool enable) { nagle = enable; }
+    
+    /**
+     * Appends data to the host buffer, flushing it when the threshold is
+     * reached. Data not fitting is accepted only if a flush makes room
+     * \param data: data to be sent
+     * \param len: number of bytes
+     * \param now: current time
+     * \return number of bytes accepted, less than len if the chip's TX
+     * buffer is full
+     */
+    uint16_t write(const uint8_t *data, uint16_t len, uint32_t now)
+    {
+        uint16_t accepted = 0;
+        
+        while(accepted < len)
+        {
+            if(count == SIZE)
+            {
+                flush();
+                if(count == SIZE)
+                    break;
+            }
+            
+            if(count == 0)
+                since = now;
+            
+            if(accepted == 0)
+            {
+                newest = now;
+                newestAt = count;
+            }
+            
+            uint16_t n = len - accepted;
+            if(n > SIZE - count)
+                n = SIZE - count;
+            
+            memcpy(buffer + count, data + accepted, n);
+            count += n;
+            accepted += n;
+            
+            if(count >= threshold)
+                flush();
+        }
+        
+        return accepted;
+    }
+    
+    /**
+     * Moves buffered data to the chip with one burst and issues SEND.
+     * If the chip's TX buffer has less room than needed only part of the
+     * data is moved, the rest stays buffered. Nothing is done while the
+     * previous SEND is in progress
+     * \return true if the host buffer is now empty
+     */
+    bool flush()
+    {
+        if(count == 0 && !unsent)
+            return true;
+        
+        if(!sendCompleted())
+            return count == 0;
+        
+        uint16_t free = chip.getTxFreeSize(sockNum);
+        uint16_t n = count < free ? count : free;
+        
+        if(n > 0)
+        {
+            chip.writeData(sockNum, buffer, n);
+            unsent = true;
+            
+            count -= n;
+            if(count > 0)
+                memmove(buffer, buffer + n, count);
+            
+            /* once only the latest write's data is left its time is that of
+               the oldest byte, otherwise the older time is kept */
+            if(newestAt <= n)
+            {
+                since = newest;
+                newestAt = 0;
+            }
+            else
+                newestAt -= n;
+        }
+        
+        /* if the command fails data stays in the chip ring, to go with
+           the SEND issued by next flush */
+        if(unsent && chip.issueSocketCommand(sockNum, SOCKn_CR_SEND))
+        {
+            unsent = false;
+            inFlight = true;
+        }
+        
+        return count == 0;
+    }
+    
+    /**
+     * Applies the time and Nagle flush conditions, to be called
+     * periodically
+     * \param now: current time
+     */
+    void poll(uint32_t now)
+    {
+        if(count == 0)
+        {
+            if(unsent)
+                flush();
+            
+            return;
+        }
+        
+        /* a flush moving nothing leaves the time as is, to be retried by
+           the next call */
+        if(maxDelay != 0 && now - since >= maxDelay)
+        {
+            flush();
+            return;
+        }
+        
+        if(nagle && chip.getTxFreeSize(sockNum) == chip.getTxBufSize(sockNum))
+            flush();
+    }
+    
+    /**
+     * \return number of bytes waiting in the host buffer
+     */
+    uint16_t pending() const { return count; }
+    
+    /**
+     * Drops buffered data, for example when the connection is closed
+     */
+    void discard()
+    {
+        count = 0;
+        inFlight = false;
+        unsent = false;
+    }
+
+private:
+
+    TxCoalescer(const TxCoalescer&);
+    TxCoalescer& operator=(const TxCoalescer&);
+    
+    /* true once the chip is done with the last SEND. The SEND_OK flag may
+       have been consumed by an interrupt handler, so an empty TX buffer is
+       taken as completion too. TIMEOUT is left for the application to see */
+    bool sendCompleted()
+    {
+        if(!inFlight)
+            return true;
+        
+        uint8_t flags = chip.getSocketInterruptReg(sockNum);
+        
+        if((flags & SOCKn_IR_SEND_OK) == 0 &&
+           chip.getTxFreeSize(sockNum) != chip.getTxBufSize(sockNum))
+            return false;
+        
+        if(flags & SOCKn_IR_SEND_OK)
+            chip.clearSocketInterruptFlags(sockNum, SOCKn_IR_SEND_OK);
+        
+        inFlight = false;
+        return true;
+    }
+    
+    Chip& chip;
+    SOCKET sockNum;
+    uint16_t threshold;             //buffered bytes triggering a flush
+    uint32_t maxDelay;              //maximum holding time
+    bool nagle;                     //flush when nothing is in flight
+    bool inFlight;                  //SEND issued and not completed yet
+    bool unsent;                    //data written to the chip without SEND
+    uint16_t count;                 //bytes in buffer
+    uint32_t since;                 //time the oldest buffered byte was written
+    uint32_t newest;                //time of the latest write
+    uint16_t newestAt;              //offset in buffer of the latest write's data
+    uint8_t buffer[SIZE];
+};
+
+#endif // TX_COALESCER_H
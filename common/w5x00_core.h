@@ -0,0 +1,852 @@
+/*
+ * Driver core shared by Wiznet W5x00 chips
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef W5X00_CORE_H
+#define W5X00_CORE_H
+
+#include <stdint.h>
+#include "w5x00_defs.h"
+#include "spsc_queue.h"
+#include "lock_policy.h"
+#include "perf_counters.h"
+#include "latency_histogram.h"
+#include "spi_trace.h"
+#include "socket_timeline.h"
+
+typedef uint8_t SOCKET;
+
+/* default maximum number of command register checks while
+   waiting for a socket command to complete */
+const unsigned int CMD_WAIT_ATTEMPTS   = 0xFFFF;
+
+/* maximum number of passes over the socket interrupt summary done by the
+   interrupt service helpers, bounds their time under an event flood */
+const unsigned int INT_DRAIN_PASSES    = 4;
+
+/* capacity of socket event queue, must be a power of two */
+const unsigned int SOCKET_EVENT_QUEUE_SIZE = 16;
+
+/**
+ * Function called for each socket event serviced by the driver
+ * \param sockNum: socket number
+ * \param flags: socket's interrupt register value
+ * \param arg: user defined argument
+ */
+typedef void (*SocketEventHandler)(SOCKET sockNum, uint8_t flags, void *arg);
+
+/**
+ * Function called by the receive poller for each socket having data
+ * \param sockNum: socket number
+ * \param rxSize: number of bytes waiting in socket's RX buffer
+ * \param arg: user defined argument
+ */
+typedef void (*SocketRxHandler)(SOCKET sockNum, uint16_t rxSize, void *arg);
+
+/**
+ * Function called while waiting for a socket command to complete, can be
+ * used to yield the CPU to other tasks or to implement a backoff policy
+ * \param attempt: number of completion checks already failed
+ */
+typedef void (*CommandWaitHook)(uint16_t attempt);
+
+/**
+ * Socket readiness information, as returned by pollSockets()
+ */
+struct SocketPollInfo
+{
+    uint8_t status;     //socket's status register
+    uint8_t flags;      //socket's interrupt flags, cleared by the poll
+    uint16_t rxSize;    //bytes waiting in socket's RX buffer
+    uint16_t txFree;    //free space in socket's TX buffer
+};
+
+/**
+ * Socket event record, as queued by queueSocketEvents()
+ */
+struct SocketEvent
+{
+    SOCKET socket;      //socket number
+    uint8_t flags;      //socket's interrupt register value
+    uint16_t rxSize;    //received size snapshot, taken when RECV is flagged
+};
+
+/**
+ * Queue used to pass socket events from interrupt context to tasks
+ */
+typedef SpscQueue<SocketEvent, SOCKET_EVENT_QUEUE_SIZE> SocketEventQueue;
+
+/**
+ * Chip configuration applied by bringUp(). It is an aggregate meant to be
+ * declared constexpr, or static const, so that it is built at compile time
+ * and kept in flash
+ */
+struct ChipConfig
+{
+    uint8_t mode;           //MR flags, MR_RST excluded. Interface mode bits, such as
+                            //W5100 indirect bus ones, are kept by the bus policy
+                            //and ignored by bringUp() verification
+    uint8_t mac[6];         //MAC address
+    uint8_t ip[4];          //IP address
+    uint8_t subnet[4];      //subnet mask
+    uint8_t gateway[4];     //gateway IP address
+    uint16_t retryTime;     //retransmission timeout in units of 100us
+    uint8_t retryCount;     //number of retransmissions
+    uint8_t intMask;        //as for setInterruptMask()
+    uint8_t sockIntMask;    //as for setSocketInterruptMask()
+    uint8_t rxMemKb[8];     //sockets RX buffer size in kB, as for setSocketRxMemSize(),
+    uint8_t txMemKb[8];     //and TX one, entries past the chip's sockets are unused
+};
+
+/**
+ * Driver core common to all the W5x00 chips, chip drivers derive from it
+ * adding their specific features. Everything that differs between chips is
+ * described by the Traits class, whose members are compile time constants:
+ * - Address: type of a chip's memory address
+ * - MAX_SOCK_NUM: number of sockets
+ * - MR, GAR, SUBR, SHAR, SIPR, IR, IMR, RTR, RCR: common registers addresses
+ * - SOCK_IR, SOCK_IMR: socket interrupt summary and mask registers,
+ *   SOCK_IR_BITS is the mask of their bits flagging sockets and
+ *   SOCK_IMR_SHARED tells if the mask register is IMR itself, otherwise
+ *   each socket has its own Sn_IMR too
+ * - INTLEVEL, PHY: interrupt low level timer and PHY status registers,
+ *   present if HAS_INTLEVEL and HAS_PHY are true; INTLEVEL_MAX_DELAY is the
+ *   longest interrupt coalescing delay in microseconds. HAS_SOCK_FRAG tells
+ *   if sockets have the Sn_FRAG register and HAS_IPRAW if they have IPRAW
+ *   mode and its Sn_PROTO register
+ * - socketReg(s, offset): address of a socket register
+ * - txBuffer(s, offset), rxBuffer(s, offset): address of a socket buffer
+ *   location; when BUFFER_WRAP_IN_CHIP is false offset is relative to the
+ *   start of TX/RX memory and the driver handles ring wrapping, otherwise
+ *   it is socket's buffer pointer and the chip wraps it
+ * - memSizeReg(s, tx), memSizeValue(current, s, kB): register and value
+ *   configuring a socket's buffer size, MEM_SIZE_SHARED tells if the
+ *   register is shared between sockets and has to be read-modified-written,
+ *   MEM_TOTAL_KB is the size in kB of TX memory and of RX memory
+ * - COMMON_BLOCK_END: address past the common registers written in one
+ *   burst by bringUp(), from MR up to RCR at least; MR_INTERFACE_BITS is
+ *   the mask of MR bits set by the interface, not compared on verification
+ * - CHIP_ID: chip model number, tags SPI traces
+ * - BURST_FRAMES: true if a multi-byte access costs a single SPI frame
+ * - read(spi, address, data, len), write(spi, address, data, len): SPI
+ *   frame encoding, given a transport policy object
+ * \param Traits: chip traits class
+ * \param Transport: SPI transport policy, see spi_impl.h
+ */
+template<class Traits, class Transport>
+class W5x00Core
+{
+public:
+
+    typedef typename Traits::Address Address;
+    
+    /* types and constants used by code generic over the chip type */
+    typedef SocketPollInfo PollInfo;
+    static const unsigned char socketCount = Traits::MAX_SOCK_NUM;
+    static const unsigned char bufferMemoryKb = Traits::MEM_TOTAL_KB;
+    
+    /**
+     * Set chip's MAC address
+     */
+    void setMacAddress(const uint8_t *address);
+    
+    /**
+     * Set chip's IP address
+     */
+    void setIpAddress(uint8_t *address);
+    
+    /**
+     * Set network's subnet mask
+     */
+    void setSubnetMask(uint8_t *mask);
+    
+    /**
+     * Set network's gateway IP address
+     */
+    void setGatewayAddress(uint8_t *address);
+    
+    /**
+     * Set Mode register flags
+     */
+    void setModeReg(uint8_t value);
+    
+    /**
+     * Set retransmission timeout period in units of 100us each
+     * for example to set timeout period to 400ms you have to set
+     * this register to 0x4000
+     */
+    void setRetryTime(uint16_t value);
+    
+    /**
+     * Configures the number of retransmissions
+     */
+    void setRetryCount(uint16_t value);
+    
+    /**
+     * Configures chip's interrupt mask register
+     */
+    void setInterruptMask(uint8_t mask);
+    
+    /**
+     * \return chip's interrupt register value
+     */
+    uint8_t readInterruptReg();
+    
+    /**
+     * \return socket interrupt summary, one bit per socket
+     */
+    uint8_t readSocketInterruptReg();
+    
+    /**
+     * Configures which sockets can raise an interrupt, one bit per socket
+     */
+    void setSocketInterruptMask(uint8_t mask);
+    
+    /**
+     * Services all the pending socket interrupts: for each socket flagged
+     * in the interrupt summary reads and clears its interrupt register and
+     * calls the handler. The process is repeated until the summary reads
+     * zero, so that all the events coalesced in a single interrupt are
+     * drained, but at most INT_DRAIN_PASSES times: under an event flood the
+     * remaining events stay latched and keep the interrupt asserted, to be
+     * serviced by the next call. Meant to be called from the interrupt
+     * handler or from the task woken by it
+     * \param handler: function called for each socket event, may be null
+     * \param arg: argument passed to the handler
+     * \return number of socket events serviced
+     */
+    uint16_t drainSocketInterrupts(SocketEventHandler handler, void *arg);
+    
+    /**
+     * Configures the interrupt low level timer (INTLEVEL register).
+     * Once an interrupt has been serviced the INTn pin is not asserted
+     * again until this time has elapsed, so that the events occurring
+     * in the meantime are signalled by a single interrupt.
+     * Time unit is 4 PLL clock cycles, that is about 26.7ns.
+     * Does nothing on chips without the timer, like W5100
+     * \param value: register value, 0 disables the timer
+     */
+    void setInterruptLowLevelTimer(uint16_t value);
+    
+    /**
+     * Configures interrupt coalescing, trading interrupt latency for
+     * throughput: the greater the delay, the more socket events are
+     * serviced by a single interrupt
+     * \param maxDelay: maximum interrupt assertion delay in microseconds,
+     * values greater than INTLEVEL_MAX_DELAY are saturated. 0 disables
+     * coalescing, giving one interrupt per event
+     */
+    void setInterruptCoalescing(uint16_t maxDelay);
+    
+    /**
+     * \return value of register that indicates chip's physical status,
+     * see PHY_* values for link, speed and duplex on W5500. Always 0 on
+     * chips without the register, like W5100
+     */
+    uint8_t getPhyStatus();
+    
+    /**
+     * Switches to polled receive mode, to be called upon the first RECV
+     * interrupt: socket interrupts are masked and the sockets are then
+     * serviced by pollReceive() until traffic drains.
+     * Events other than RECV remain latched in the sockets' interrupt
+     * registers and are signalled as soon as interrupts are enabled again
+     */
+    void enterRxPolling();
+    
+    /**
+     * \return true if the driver is in polled receive mode
+     */
+    bool isRxPolling() const { return rxPolling; }
+    
+    /**
+     * Polls the received size of the sockets enabled in the socket interrupt
+     * mask, in round robin order, calling the handler for each one having
+     * data; the handler is expected to consume it. When a whole pass finds
+     * no data the sockets' RECV flags are cleared and socket interrupts are
+     * enabled again
+     * \param budget: maximum number of handler calls
+     * \param handler: function called for each socket having data
+     * \param arg: argument passed to the handler
+     * \return true if traffic drained and interrupts have been re-enabled,
+     * false if the budget was exhausted and pollReceive() has to be called
+     * again
+     */
+    bool pollReceive(uint16_t budget, SocketRxHandler handler, void *arg);
+    
+    /**
+     * Writes socket's mode register
+     * \param sockNum: socket number
+     * \param value: value to be written
+     */
+    void setSocketModeReg(SOCKET sockNum, uint8_t value);
+    
+    /**
+     * Used to send a command to a socket through its command register
+     * \param sockNum: socket number
+     * \param value: command opcode
+     */
+    void setSocketCommandReg(SOCKET sockNum, uint8_t value);
+    
+    /**
+     * Used to get register's value, as a way to check if a given command is completed
+     * \param sockNum: socket number
+     * \return register's value
+     */
+    uint8_t getSocketCommandReg(SOCKET sockNum);
+    
+    /**
+     * Sends a command to a socket without waiting for its completion,
+     * which is checked only when needed, that is before the next command
+     * or status query on the same socket. If a command previously issued
+     * on the socket is still in progress it is waited for first
+     * \param sockNum: socket number
+     * \param command: command opcode
+     * \return false if the previous command did not complete in time, in
+     * which case the new command is not issued
+     */
+    bool issueSocketCommand(SOCKET sockNum, uint8_t command);
+    
+    /**
+     * Waits for the completion of the command issued on a socket through
+     * issueSocketCommand(), if any. The command register is checked at most
+     * the number of times configured with setCommandWaitHook(), calling the
+     * wait hook between consecutive checks
+     * \param sockNum: socket number
+     * \return true if no command is in progress on the socket
+     */
+    bool waitSocketCommand(SOCKET sockNum);
+    
+    /**
+     * \param sockNum: socket number
+     * \return true if a command issued on the socket has not been
+     * checked for completion yet
+     */
+    bool isSocketCommandPending(SOCKET sockNum) const
+    {
+        return cmdPending[sockNum];
+    }
+    
+    /**
+     * Configures how socket command completion is waited for
+     * \param hook: function called between two consecutive checks of the
+     * command register, null to busy wait
+     * \param maxAttempts: maximum number of checks before giving up
+     */
+    void setCommandWaitHook(CommandWaitHook hook, uint16_t maxAttempts);
+    
+    /**
+     * Reads socket's interrupt register
+     * \param sockNum: socket number
+     * \return socket's interrupt register value
+     */
+    uint8_t getSocketInterruptReg(SOCKET sockNum);
+    
+    /**
+     * Resets all the socket's interrupt register flags
+     * \param sockNum: socket number
+     */
+    void clearSocketInterruptReg(SOCKET sockNum);
+    
+    /**
+     * Resets some of the socket's interrupt register flags
+     * \param sockNum: socket number
+     * \param flags: flags to be reset
+     */
+    void clearSocketInterruptFlags(SOCKET sockNum, uint8_t flags);
+    
+    /**
+     * Configures the socket interrupts that will be signalled. Does nothing
+     * on chips masking sockets only as a whole, like W5100
+     * \param sockNum: socket number
+     * \param value: mask value
+     */
+    void setSocketInterruptMaskReg(SOCKET sockNum, uint8_t value);
+    
+    /**
+     * Sets Fragment field value in socket's IP header. Does nothing on
+     * chips without the register, like W5100
+     * \param sockNum: socket number
+     * \param value: field value
+     */
+    void setSocketFragmentValue(SOCKET sockNum, uint16_t value);
+    
+    /**
+     * Reads socket's status register
+     * \param sockNum: socket number
+     * \return socket's status register value
+     */
+    uint8_t getSocketStatusReg(SOCKET sockNum);
+    
+    /**
+     * Sets socket's source port value, both for TCP and UDP
+     * \param sockNum: socket number
+     * \param port: socket's source port number
+     */
+    void setSocketSourcePort(SOCKET sockNum, uint16_t port);
+    
+    /**
+     * Sets socket's destination MAC address
+     * \param sockNum: socket number
+     * \param destMAC: socket's destination MAC address
+     */
+    void setSocketDestMac(SOCKET sockNum, uint8_t *destMAC);
+    
+    /**
+     * Sets socket's destination IP address
+     * \param sockNum: socket number
+     * \param destIP: socket's destination IP address
+     */
+    void setSocketDestIp(SOCKET sockNum, uint8_t *destIP);
+    
+    /**
+     * Sets socket's destination port number
+     * \param sockNum: socket number
+     * \param destPort: socket's destination port number
+     */
+    void setSocketDestPort(SOCKET sockNum, uint16_t destPort);
+    
+    /**
+     * Set socket's Maximum Segment Size for TCP mode
+     * \param sockNum: socket number
+     * \param value: MSS value
+     */
+    void setSocketMSS(SOCKET sockNum, uint16_t value);
+    
+    /**
+     * Set socket's protocol number when used in IPraw mode. Does nothing on
+     * chips without IPRAW mode, as W5500
+     * \param sockNum: socket number
+     * \param value: protocol number
+     */
+    void setSocketProtocolValue(SOCKET sockNum, uint8_t value);
+    
+    /**
+     * Sets Type Of Service field value in socket's IP header
+     * \param sockNum: socket number
+     * \param TOSvalue: field value
+     */
+    void setSocketTos(SOCKET sockNum, uint8_t TOSvalue);
+    
+    /**
+     * Sets Time To Live field value in socket's IP header
+     * \param sockNum: socket number
+     * \param TTLvalue: field value
+     */
+    void setSocketTtl(SOCKET sockNum, uint8_t TTLvalue);
+    
+    /**
+     * Configures socket's internal RX memory size, refer to chip's
+     * datasheet for the accepted values. Buffers are laid out in socket
+     * order, so resizing a socket moves the buffers of the following ones:
+     * they must not be in use
+     * \param sockNum: socket number
+     * \param memSize: desired RX memory size in kB
+     */
+    void setSocketRxMemSize(SOCKET sockNum, uint8_t memSize);
+    
+    /**
+     * Configures socket's internal TX memory size, refer to chip's
+     * datasheet for the accepted values. Buffers are laid out in socket
+     * order, so resizing a socket moves the buffers of the following ones:
+     * they must not be in use
+     * \param sockNum: socket number
+     * \param memSize: desired TX memory size in kB
+     */
+    void setSocketTxMemSize(SOCKET sockNum, uint8_t memSize);
+    
+    /**
+     * Resets the chip and applies a whole configuration with as few SPI
+     * frames as possible: MR_RST is issued and MR polled until the reset
+     * ends, calling the command wait hook between polls, then the common
+     * registers from MR to RCR are written with one burst and the memory
+     * size registers and interrupt masks that do not lie in it with one
+     * burst each, skipping the sockets left at the reset default of 2kB.
+     * Replaces the sequence of setters otherwise used at startup, all the
+     * sockets must be closed
+     * \param config: configuration to be applied
+     * \param verify: if true the registers written are read back and
+     * compared with the configuration
+     * \return false if the reset did not end within the number of checks
+     * set with setCommandWaitHook() or if verification failed
+     */
+    bool bringUp(const ChipConfig& config, bool verify = false);
+    
+    /**
+     * Writes data into socket TX buffer and updates in-chip pointer
+     * \param sockNum: socket number
+     * \param data: pointer to buffer containing data to be written
+     * \param len: number of bytes to be written
+     */
+    void writeData(SOCKET sockNum, const uint8_t *data, uint16_t len);
+    
+    /**
+     * Reads data from socket RX buffer and updates in-chip pointer
+     * \param sockNum: socket number
+     * \param data: pointer to buffer in which write data
+     * \param len: number of bytes to be read
+     */
+    void readData(SOCKET sockNum, uint8_t *data, uint16_t len);
+    
+    /**
+     * Discards data from socket RX buffer, only advancing in-chip pointer
+     * \param sockNum: socket number
+     * \param len: number of bytes to be discarded
+     */
+    void skipData(SOCKET sockNum, uint16_t len);
+    
+    /**
+     * \param sockNum: socket number
+     * \return the received data size in byte
+     */
+    uint16_t getReceivedSize(SOCKET sockNum);
+    
+    /**
+     * \param sockNum: socket number
+     * \return the free space in socket's TX buffer in byte
+     */
+    uint16_t getTxFreeSize(SOCKET sockNum);
+    
+    /**
+     * \param sockNum: socket number
+     * \return size of socket's TX buffer in byte
+     */
+    uint16_t getTxBufSize(SOCKET sockNum) const { return txBufSize[sockNum]; }
+    
+    /**
+     * \param sockNum: socket number
+     * \return size of socket's RX buffer in byte
+     */
+    uint16_t getRxBufSize(SOCKET sockNum) const { return rxBufSize[sockNum]; }
+    
+    /**
+     * Collects the readiness state of a set of sockets in a single pass,
+     * with the minimum number of SPI frames: the socket interrupt summary
+     * is read once and each socket's registers are read in bursts.
+     * Interrupt flags reported are cleared
+     * \param sockMask: bitmask of the sockets to be polled
+     * \param info: array of MAX_SOCK_NUM elements, only the entries of
+     * polled sockets are written
+     * \return bitmask of polled sockets having received data or
+     * interrupt flags set
+     */
+    uint8_t pollSockets(uint8_t sockMask, SocketPollInfo *info);
+    
+    /**
+     * Interrupt service helper: reads and clears the interrupt flags of all
+     * the sockets signalling an interrupt and appends an event record for
+     * each of them to the queue, which the application drains from task
+     * context. Registers are accessed directly, without waiting for any
+     * pending socket command, to keep time spent in interrupt context low.
+     * The interrupt must not preempt an SPI transaction in progress and,
+     * when a locking policy is in use, this function has to be called from
+     * the task woken by the interrupt rather than from the handler itself.
+     * As drainSocketInterrupts(), does at most INT_DRAIN_PASSES passes.
+     * When the queue is full it stops without clearing the flags of the
+     * remaining sockets, so no event is lost: the interrupt line stays
+     * asserted and they are queued by the next call
+     * \param queue: queue to be filled, this function is its only producer
+     * \return number of events queued
+     */
+    uint16_t queueSocketEvents(SocketEventQueue& queue);
+    
+    /**
+     * Copies the performance counters, which are kept only when the
+     * driver is built with W5X00_PERF_COUNTERS defined
+     * \param chip: filled with the chip's SPI traffic counters
+     * \param sockets: if not null, array of MAX_SOCK_NUM elements filled
+     * with the sockets' counters
+     * \return false if counters are compiled out
+     */
+    bool getPerfCounters(ChipCounters& chip, SocketCounters *sockets) const
+    {
+        return perf.snapshot(chip, sockets);
+    }
+    
+    /**
+     * Zeroes the performance counters
+     */
+    void resetPerfCounters() { perf.reset(); }
+    
+    /**
+     * Sets the clock used to measure latencies and to timestamp the sockets'
+     * timelines, which are recorded only when the driver is built with
+     * W5X00_LATENCY_HISTOGRAMS or W5X00_SOCKET_TIMELINE defined and a clock
+     * is set. Operations in progress are forgotten and timelines emptied
+     * \param hook: function returning the current time, null to stop
+     */
+    void setTimestampHook(TimestampHook hook)
+    {
+        latency.setHook(hook);
+        timeline.setHook(hook);
+    }
+    
+    /**
+     * \param metric: latency measured
+     * \return its histogram, null if histograms are compiled out
+     */
+    const LatencyHistogram *getLatencyHistogram(LatencyMetric metric) const
+    {
+        return latency.histogram(metric);
+    }
+    
+    /**
+     * Passes every non empty bucket of all the latency histograms to a
+     * function, for example to print them or send them to a collector
+     * \param hook: function called for each bucket
+     * \param arg: argument passed to hook
+     */
+    void exportLatencyHistograms(LatencyExportHook hook, void *arg) const
+    {
+        latency.exportTo(hook, arg);
+    }
+    
+    /**
+     * Empties the latency histograms
+     */
+    void resetLatencyHistograms() { latency.reset(); }
+    
+    /**
+     * Copies the last status transitions, connection commands and
+     * connection interrupts seen on a socket, which are recorded only when
+     * the driver is built with W5X00_SOCKET_TIMELINE defined
+     * \param sockNum: socket number
+     * \param entries: destination buffer, if too small the newest entries
+     * are copied
+     * \param max: number of entries fitting in entries, up to
+     * SOCKET_TIMELINE_DEPTH are kept
+     * \return number of entries copied, oldest first
+     */
+    uint8_t getSocketTimeline(SOCKET sockNum, SocketTransition *entries, uint8_t max) const
+    {
+        return timeline.read(sockNum, entries, max);
+    }
+    
+    /**
+     * Gives the durations of the last connection setup and teardown of a
+     * socket and the time the application took to open it again after it
+     * was closed, measured from its timeline
+     * \param sockNum: socket number
+     * \param times: filled with the durations
+     * \return false if the timeline is compiled out
+     */
+    bool getConnectionTimes(SOCKET sockNum, ConnectionTimes& times) const
+    {
+        return timeline.times(sockNum, times);
+    }
+    
+    /**
+     * Empties the timelines of all the sockets
+     */
+    void resetSocketTimelines() { timeline.reset(); }
+    
+    /**
+     * Starts recording every chip access into a ring buffer, overwriting
+     * the oldest records when it is full. Only available when the driver
+     * is built with W5X00_SPI_TRACE defined
+     * \param ring: record buffer, owned by the application
+     * \param size: number of records in ring
+     * \param clock: function returning the current time, may be null
+     */
+    void startSpiTrace(SpiTraceRecord *ring, uint32_t size, TimestampHook clock);
+    
+    /**
+     * Stops recording, records are kept until the next start
+     */
+    void stopSpiTrace();
+    
+    /**
+     * Copies the recorded accesses, oldest first, and fills the header to
+     * be saved in front of them for the trace tools
+     * \param header: trace header
+     * \param records: destination buffer, if too small the newest records
+     * are copied
+     * \param max: number of records fitting in records
+     * \return number of records copied, 0 if the recorder is compiled out
+     */
+    uint32_t readSpiTrace(SpiTraceHeader& header, SpiTraceRecord *records, uint32_t max);
+
+protected:
+
+    /**
+     * \param transport: SPI transport policy object the chip is attached to
+     */
+    explicit W5x00Core(const Transport& transport);
+    
+    /**
+     * Write one byte into chip's register
+     * \param address: register's address
+     * \param data: data to be written
+     */
+    void writeRegister(Address address, uint8_t data);
+    
+    /**
+     * Write a 16 bit big endian value into a pair of chip's registers
+     * \param address: upper byte register's address
+     * \param data: data to be written
+     */
+    void writeRegister16(Address address, uint16_t data);
+    
+    /**
+     * Write multiple bytes into chip's memory
+     * \param address: writing process start point address
+     * \param data: pointer to the data to be written
+     * \param len: number of bytes to be written
+     * \param op: operation type the transfer is counted as
+     */
+    void writeBuffer(Address address, const uint8_t *data, uint16_t len,
+                     SpiOperation op = SPI_REG_WRITE);
+    
+    /**
+     * Read one byte from chip's register
+     * \param address: register's address
+     * \return data read
+     */
+    uint8_t readRegister(Address address);
+    
+    /**
+     * Read a 16 bit big endian value from a pair of chip's registers
+     * \param address: upper byte register's address
+     * \return data read
+     */
+    uint16_t readRegister16(Address address);
+    
+    /**
+     * Read multiple bytes into chip's memory
+     * \param address: reading process start point address
+     * \param data: pointer to the data to be read
+     * \param len: number of bytes to be read
+     * \param op: operation type the transfer is counted as
+     */
+    void readBuffer(Address address, uint8_t *data, uint16_t len,
+                    SpiOperation op = SPI_REG_READ);
+    
+    /**
+     * Copies data from application buffer to socket's in-chip TX buffer,
+     * splitting the copy in two when it crosses the end of the ring
+     * \param socket: socket number
+     * \param src: pointer to source buffer
+     * \param dst: socket's TX write pointer value the copy starts from
+     * \param len: number of bytes to be copied
+     */
+    void writeTxBuf(SOCKET socket, const uint8_t *src, uint16_t dst, uint16_t len);
+    
+    /**
+     * Copies data from socket's in-chip RX buffer to application buffer,
+     * splitting the copy in two when it crosses the end of the ring
+     * \param socket: socket number
+     * \param src: socket's RX read pointer value the copy starts from
+     * \param dst: pointer to destination buffer
+     * \param len: number of bytes to be copied
+     */
+    void readRxBuf(SOCKET socket, uint16_t src, uint8_t *dst, uint16_t len);
+    
+    /**
+     * Waits for command completion, socket's lock must be held
+     * \param sockNum: socket number
+     * \return true if no command is in progress on the socket
+     */
+    bool waitCommand(SOCKET sockNum);
+    
+    /**
+     * Writes the socket interrupt mask register, preserving the other
+     * interrupts' bits when it is shared with IMR. Common lock must be held
+     * \param mask: socket interrupt mask
+     */
+    void writeSocketIntMask(uint8_t mask);
+    
+    /**
+     * Configures a socket's buffer size and updates buffers layout
+     * \param sockNum: socket number
+     * \param memSize: buffer size in kB
+     * \param tx: true for TX buffer, false for RX buffer
+     */
+    void setMemSize(SOCKET sockNum, uint8_t memSize, bool tx);
+    
+    /**
+     * Computes the buffers offsets from their sizes, buffers are allotted
+     * in socket order
+     */
+    void layoutBuffers();
+    
+    /**
+     * Writes a register set by bringUp(), or stores it in the common
+     * registers image when it lies in the common block
+     * \param image: common registers image, starting at MR
+     * \param address: register's address
+     * \param value: value to be written
+     */
+    void putConfigRegister(uint8_t *image, Address address, uint8_t value);
+    
+    /**
+     * Checks a register set by bringUp()
+     * \param image: common registers read back, starting at MR
+     * \param address: register's address
+     * \param value: expected value
+     * \return true if the register holds the expected value
+     */
+    bool checkConfigRegister(const uint8_t *image, Address address, uint8_t value);
+    
+    /**
+     * \param address: chip address accessed
+     * \param op: access type
+     * \return socket the address belongs to, SPI_TRACE_NO_SOCKET if none
+     */
+    uint8_t socketOf(Address address, SpiOperation op) const;
+    
+    Transport spi;                      //transport the chip is attached to
+    
+    uint16_t txBufSize[Traits::MAX_SOCK_NUM];   //sockets TX buffer size in byte
+    uint16_t rxBufSize[Traits::MAX_SOCK_NUM];   //sockets RX buffer size in byte
+    uint16_t txBufBase[Traits::MAX_SOCK_NUM];   //sockets TX buffer offset in TX memory
+    uint16_t rxBufBase[Traits::MAX_SOCK_NUM];   //sockets RX buffer offset in RX memory
+    
+    bool cmdPending[Traits::MAX_SOCK_NUM];      //sockets with a command not yet completed
+    CommandWaitHook cmdWaitHook;        //called while waiting for a command
+    uint16_t cmdMaxAttempts;            //command completion checks before timeout
+    
+    uint8_t intMask;                    //IMR value set by the application
+    uint8_t sockIntMask;                //socket interrupt mask set by the application
+    bool rxPolling;                     //polled receive mode active
+    SOCKET rxPollNext;                  //first socket checked by next poll
+    
+    PerfCounters<Traits::MAX_SOCK_NUM> perf;    //empty unless W5X00_PERF_COUNTERS
+    LatencyStats<Traits::MAX_SOCK_NUM> latency; //empty unless W5X00_LATENCY_HISTOGRAMS
+    SpiTracer trace;                            //empty unless W5X00_SPI_TRACE
+    SocketTimeline<Traits::MAX_SOCK_NUM> timeline;  //empty unless W5X00_SOCKET_TIMELINE
+    
+    /* bus lock is held for each group of SPI frames, socket locks for the
+       sequences involving socket's registers and pointers. When both are
+       needed socket's lock is always acquired first. The bus lock is the
+       one the transport shares among the chips on its bus, if any, and
+       ownBusMutex otherwise */
+    DriverMutex ownBusMutex;
+    DriverMutex& busMutex;
+    DriverMutex sockMutex[Traits::MAX_SOCK_NUM];
+    DriverMutex commonMutex;            //read-modify-write of common state
+
+private:
+
+    W5x00Core(const W5x00Core&);
+    W5x00Core& operator=(const W5x00Core&);
+};
+
+#include "w5x00_core_impl.h"
+
+#endif // W5X00_CORE_H
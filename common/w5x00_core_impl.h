@@ -0,0 +1,1054 @@
+/*
+ * Driver core shared by Wiznet W5x00 chips, member functions definitions
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+/*
+ * Included by w5x00_core.h, do not include this file directly
+ */
+
+#ifndef W5X00_CORE_IMPL_H
+#define W5X00_CORE_IMPL_H
+
+#include <algorithm>
+
+template<class Traits, class Transport>
+W5x00Core<Traits, Transport>::W5x00Core(const Transport& transport) : spi(transport),
+    cmdWaitHook(0), cmdMaxAttempts(CMD_WAIT_ATTEMPTS), intMask(0), sockIntMask(0),
+    rxPolling(false), rxPollNext(0),
+    busMutex(BusLockOf<Transport>::of(spi) ? *BusLockOf<Transport>::of(spi) : ownBusMutex)
+{
+    /* initialize RX and TX buffer size vectors to default value,
+       which is 2kB */
+    
+    std::fill(txBufSize, txBufSize + Traits::MAX_SOCK_NUM, 0x02 << 10);
+    std::fill(rxBufSize, rxBufSize + Traits::MAX_SOCK_NUM, 0x02 << 10);
+    std::fill(cmdPending, cmdPending + Traits::MAX_SOCK_NUM, false);
+    
+    for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+    {
+        txBufBase[i] = i * (0x02 << 10);
+        rxBufBase[i] = i * (0x02 << 10);
+    }
+    
+    spi.init(); //start SPI bus if needed
+}
+
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setMacAddress(const uint8_t* address)
+{
+    writeBuffer(Traits::SHAR, address, 6);
+}
+
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setIpAddress(uint8_t* address)
+{
+    writeBuffer(Traits::SIPR, address, 4);
+}
+
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSubnetMask(uint8_t* mask)
+{
+    writeBuffer(Traits::SUBR, mask, 4);
+}
+
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setGatewayAddress(uint8_t* address)
+{
+    writeBuffer(Traits::GAR, address, 4);
+}
+
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setModeReg(uint8_t value)
+{
+    writeRegister(Traits::MR, value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setInterruptMask(uint8_t mask)
+{
+    LockGuard<DriverMutex> lock(commonMutex);
+    
+    intMask = mask;
+    
+    /* when IMR holds socket interrupts too, they are left masked
+       while polling and restored when leaving polled mode */
+    if(Traits::SOCK_IMR_SHARED)
+    {
+        sockIntMask = mask & Traits::SOCK_IR_BITS;
+        
+        if(rxPolling)
+            mask &= ~Traits::SOCK_IR_BITS;
+    }
+    
+    writeRegister(Traits::IMR, mask);
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::readInterruptReg()
+{
+    return readRegister(Traits::IR);
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::readSocketInterruptReg()
+{
+    return readRegister(Traits::SOCK_IR) & Traits::SOCK_IR_BITS;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketInterruptMask(uint8_t mask)
+{
+    LockGuard<DriverMutex> lock(commonMutex);
+    
+    sockIntMask = mask & Traits::SOCK_IR_BITS;
+    
+    /* while polling interrupts stay masked, the new value
+       will be applied when leaving polled mode */
+    if(!rxPolling)
+        writeSocketIntMask(sockIntMask);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::writeSocketIntMask(uint8_t mask)
+{
+    if(Traits::SOCK_IMR_SHARED)
+    {
+        intMask = (intMask & ~Traits::SOCK_IR_BITS) | mask;
+        writeRegister(Traits::SOCK_IMR, intMask);
+    
+    }else{
+        
+        writeRegister(Traits::SOCK_IMR, mask);
+    }
+}
+
+template<class Traits, class Transport>
+uint16_t W5x00Core<Traits, Transport>::drainSocketInterrupts(SocketEventHandler handler, void* arg)
+{
+    uint16_t serviced = 0;
+    uint8_t pending;
+    
+    /* new events may be flagged while the previous ones are being
+       serviced, so keep going until the summary register is clear,
+       within a bounded number of passes */
+    for(unsigned int pass = 0; pass < INT_DRAIN_PASSES; pass++)
+    {
+        pending = readRegister(Traits::SOCK_IR) & Traits::SOCK_IR_BITS;
+        if(pending == 0)
+            break;
+        
+        for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+        {
+            if((pending & (1 << i)) == 0)
+                continue;
+            
+            uint8_t flags = readRegister(Traits::socketReg(i, Sn_IR));
+            
+            /* clear only the flags read, so that events raised after
+               the read above are not lost */
+            writeRegister(Traits::socketReg(i, Sn_IR), flags);
+            perf.interrupts(i, flags);
+            latency.flags(i, flags);
+            timeline.flags(i, flags);
+            
+            if(handler)
+                handler(i, flags, arg);
+            
+            serviced++;
+        }
+    }
+    
+    return serviced;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setInterruptLowLevelTimer(uint16_t value)
+{
+    if(Traits::HAS_INTLEVEL)
+        writeRegister16(Traits::INTLEVEL, value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setInterruptCoalescing(uint16_t maxDelay)
+{
+    if(!Traits::HAS_INTLEVEL)
+        return;
+    
+    if(maxDelay == 0)
+    {
+        setInterruptLowLevelTimer(0);
+        return;
+    }
+    
+    if(maxDelay > Traits::INTLEVEL_MAX_DELAY)
+        maxDelay = Traits::INTLEVEL_MAX_DELAY;
+    
+    /* one timer tick is 4 / 150MHz = 1 / 37.5 us, register value
+       is the number of ticks minus one */
+    uint32_t ticks = (static_cast<uint32_t>(maxDelay) * 75) / 2;
+    setInterruptLowLevelTimer(static_cast<uint16_t>(ticks - 1));
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::getPhyStatus()
+{
+    return Traits::HAS_PHY ? readRegister(Traits::PHY) : 0;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::enterRxPolling()
+{
+    LockGuard<DriverMutex> lock(commonMutex);
+    
+    if(rxPolling)
+        return;
+    
+    rxPolling = true;
+    writeSocketIntMask(0x00);
+}
+
+template<class Traits, class Transport>
+bool W5x00Core<Traits, Transport>::pollReceive(uint16_t budget, SocketRxHandler handler, void* arg)
+{
+    if(!rxPolling)
+        return true;
+    
+    while(budget > 0)
+    {
+        bool found = false;
+        
+        for(SOCKET n = 0; n < Traits::MAX_SOCK_NUM && budget > 0; n++)
+        {
+            SOCKET i = (rxPollNext + n) % Traits::MAX_SOCK_NUM;
+            
+            if((sockIntMask & (1 << i)) == 0)
+                continue;
+            
+            uint16_t size = getReceivedSize(i);
+            if(size == 0)
+                continue;
+            
+            handler(i, size, arg);
+            found = true;
+            budget--;
+            
+            /* next poll starts after this socket, so that a busy
+               socket cannot starve the others */
+            rxPollNext = (i + 1) % Traits::MAX_SOCK_NUM;
+        }
+        
+        if(found)
+            continue;
+        
+        /* traffic drained: clear RECV flags and check again, data arrived
+           before clearing would not raise any interrupt once unmasked */
+        for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+        {
+            if(sockIntMask & (1 << i))
+                writeRegister(Traits::socketReg(i, Sn_IR), SOCKn_IR_RECV);
+        }
+        
+        for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+        {
+            if((sockIntMask & (1 << i)) && getReceivedSize(i) != 0)
+            {
+                found = true;
+                break;
+            }
+        }
+        
+        if(found)
+            continue;
+        
+        LockGuard<DriverMutex> lock(commonMutex);
+        rxPolling = false;
+        writeSocketIntMask(sockIntMask);
+        return true;
+    }
+    
+    return false;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketMSS(SOCKET sockNum, uint16_t value)
+{
+    writeRegister16(Traits::socketReg(sockNum, Sn_MSSR0), value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setRetryCount(uint16_t value)
+{
+    writeRegister(Traits::RCR, value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setRetryTime(uint16_t value)
+{
+    writeRegister16(Traits::RTR, value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketModeReg(SOCKET sockNum, uint8_t value)
+{
+    writeRegister(Traits::socketReg(sockNum, Sn_MR), value);
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::getSocketStatusReg(SOCKET sockNum)
+{
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    waitCommand(sockNum);
+    uint8_t status = readRegister(Traits::socketReg(sockNum, Sn_SR));
+    latency.status(sockNum, status);
+    timeline.status(sockNum, status);
+    return status;
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::getSocketInterruptReg(SOCKET sockNum)
+{
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    waitCommand(sockNum);
+    uint8_t flags = readRegister(Traits::socketReg(sockNum, Sn_IR));
+    latency.flags(sockNum, flags);
+    timeline.flags(sockNum, flags);
+    return flags;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::clearSocketInterruptReg(SOCKET sockNum)
+{
+    writeRegister(Traits::socketReg(sockNum, Sn_IR), 0xFF);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::clearSocketInterruptFlags(SOCKET sockNum, uint8_t flags)
+{
+    writeRegister(Traits::socketReg(sockNum, Sn_IR), flags);
+    perf.interrupts(sockNum, flags);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketInterruptMaskReg(SOCKET sockNum, uint8_t value)
+{
+    if(!Traits::SOCK_IMR_SHARED)
+        writeRegister(Traits::socketReg(sockNum, Sn_IMR), value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketFragmentValue(SOCKET sockNum, uint16_t value)
+{
+    if(Traits::HAS_SOCK_FRAG)
+        writeRegister16(Traits::socketReg(sockNum, Sn_FRAG0), value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketProtocolValue(SOCKET sockNum, uint8_t value)
+{
+    if(Traits::HAS_IPRAW)
+        writeRegister(Traits::socketReg(sockNum, Sn_PROTO), value);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketCommandReg(SOCKET sockNum, uint8_t value)
+{
+    writeRegister(Traits::socketReg(sockNum, Sn_CR), value);
+    perf.command(sockNum);
+    latency.command(sockNum, value);
+    timeline.command(sockNum, value);
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::getSocketCommandReg(SOCKET sockNum)
+{
+    return readRegister(Traits::socketReg(sockNum, Sn_CR));
+}
+
+template<class Traits, class Transport>
+bool W5x00Core<Traits, Transport>::issueSocketCommand(SOCKET sockNum, uint8_t command)
+{
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    
+    if(!waitCommand(sockNum))
+        return false;
+    
+    writeRegister(Traits::socketReg(sockNum, Sn_CR), command);
+    cmdPending[sockNum] = true;
+    perf.command(sockNum);
+    latency.command(sockNum, command);
+    timeline.command(sockNum, command);
+    return true;
+}
+
+template<class Traits, class Transport>
+bool W5x00Core<Traits, Transport>::waitSocketCommand(SOCKET sockNum)
+{
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    return waitCommand(sockNum);
+}
+
+template<class Traits, class Transport>
+bool W5x00Core<Traits, Transport>::waitCommand(SOCKET sockNum)
+{
+    if(!cmdPending[sockNum])
+        return true;
+    
+    for(uint16_t attempt = 0; attempt < cmdMaxAttempts; attempt++)
+    {
+        /* the chip clears command register once command is accepted */
+        if(readRegister(Traits::socketReg(sockNum, Sn_CR)) == 0)
+        {
+            cmdPending[sockNum] = false;
+            perf.commandWait(sockNum, attempt + 1);
+            return true;
+        }
+        
+        if(cmdWaitHook)
+            cmdWaitHook(attempt);
+    }
+    
+    perf.commandWait(sockNum, cmdMaxAttempts);
+    return false;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setCommandWaitHook(CommandWaitHook hook, uint16_t maxAttempts)
+{
+    cmdWaitHook = hook;
+    cmdMaxAttempts = maxAttempts;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketDestIp(SOCKET sockNum, uint8_t* destIP)
+{
+    writeBuffer(Traits::socketReg(sockNum, Sn_DIPR0), destIP, 4);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketDestMac(SOCKET sockNum, uint8_t* destMAC)
+{
+    writeBuffer(Traits::socketReg(sockNum, Sn_DHAR0), destMAC, 6);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketDestPort(SOCKET sockNum, uint16_t destPort)
+{
+    writeRegister16(Traits::socketReg(sockNum, Sn_DPORT0), destPort);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketSourcePort(SOCKET sockNum, uint16_t port)
+{
+    writeRegister16(Traits::socketReg(sockNum, Sn_SPORT0), port);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketTos(SOCKET sockNum, uint8_t TOSvalue)
+{
+    writeRegister(Traits::socketReg(sockNum, Sn_TOS), TOSvalue);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketTtl(SOCKET sockNum, uint8_t TTLvalue)
+{
+    writeRegister(Traits::socketReg(sockNum, Sn_TTL), TTLvalue);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketRxMemSize(SOCKET sockNum, uint8_t memSize)
+{
+    setMemSize(sockNum, memSize, false);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setSocketTxMemSize(SOCKET sockNum, uint8_t memSize)
+{
+    setMemSize(sockNum, memSize, true);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::setMemSize(SOCKET sockNum, uint8_t memSize, bool tx)
+{
+    LockGuard<DriverMutex> lock(commonMutex);
+    
+    typename Traits::Address reg = Traits::memSizeReg(sockNum, tx);
+    
+    /* on chips where all sockets' sizes are packed into one
+       register the other sockets' fields must be preserved */
+    uint8_t current = 0;
+    if(Traits::MEM_SIZE_SHARED)
+        current = readRegister(reg);
+    
+    writeRegister(reg, Traits::memSizeValue(current, sockNum, memSize));
+    
+    uint16_t *size = tx ? txBufSize : rxBufSize;
+    size[sockNum] = memSize << 10;
+    layoutBuffers();
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::layoutBuffers()
+{
+    /* buffers are allotted in socket order, so buffer base offsets are
+       computed once here instead of on every buffer access */
+    uint16_t txOffset = 0;
+    uint16_t rxOffset = 0;
+    for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+    {
+        txBufBase[i] = txOffset;
+        rxBufBase[i] = rxOffset;
+        txOffset += txBufSize[i];
+        rxOffset += rxBufSize[i];
+    }
+}
+
+template<class Traits, class Transport>
+bool W5x00Core<Traits, Transport>::bringUp(const ChipConfig& config, bool verify)
+{
+    LockGuard<DriverMutex> lock(commonMutex);
+    
+    /* the reset bit clears itself once the chip is ready again,
+       which takes a few register reads on all the chips */
+    writeRegister(Traits::MR, MR_RST);
+    
+    uint16_t attempt = 0;
+    while(readRegister(Traits::MR) & MR_RST)
+    {
+        if(++attempt >= cmdMaxAttempts)
+            return false;
+        
+        if(cmdWaitHook)
+            cmdWaitHook(attempt - 1);
+    }
+    
+    /* the reset dropped every socket command and the polled mode */
+    std::fill(cmdPending, cmdPending + Traits::MAX_SOCK_NUM, false);
+    rxPolling = false;
+    
+    const uint16_t imageSize = Traits::COMMON_BLOCK_END - Traits::MR;
+    uint8_t image[imageSize];
+    std::fill(image, image + imageSize, 0);
+    
+    image[0] = config.mode & ~MR_RST;
+    std::copy(config.gateway, config.gateway + 4, image + (Traits::GAR - Traits::MR));
+    std::copy(config.subnet, config.subnet + 4, image + (Traits::SUBR - Traits::MR));
+    std::copy(config.mac, config.mac + 6, image + (Traits::SHAR - Traits::MR));
+    std::copy(config.ip, config.ip + 4, image + (Traits::SIPR - Traits::MR));
+    image[Traits::RTR - Traits::MR] = config.retryTime >> 8;
+    image[Traits::RTR + 1 - Traits::MR] = config.retryTime & 0xFF;
+    image[Traits::RCR - Traits::MR] = config.retryCount;
+    
+    sockIntMask = config.sockIntMask & Traits::SOCK_IR_BITS;
+    if(Traits::SOCK_IMR_SHARED)
+    {
+        intMask = (config.intMask & ~Traits::SOCK_IR_BITS) | sockIntMask;
+        putConfigRegister(image, Traits::IMR, intMask);
+    
+    }else{
+        
+        intMask = config.intMask;
+        putConfigRegister(image, Traits::IMR, intMask);
+        putConfigRegister(image, Traits::SOCK_IMR, sockIntMask);
+    }
+    
+    /* a shared register packs all the sockets, otherwise each socket has
+       its own pair, written only if it differs from the reset default */
+    uint8_t rxShared = 0;
+    uint8_t txShared = 0;
+    for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+    {
+        rxBufSize[i] = config.rxMemKb[i] << 10;
+        txBufSize[i] = config.txMemKb[i] << 10;
+        
+        if(Traits::MEM_SIZE_SHARED)
+        {
+            rxShared = Traits::memSizeValue(rxShared, i, config.rxMemKb[i]);
+            txShared = Traits::memSizeValue(txShared, i, config.txMemKb[i]);
+            continue;
+        }
+        
+        if(config.rxMemKb[i] == 2 && config.txMemKb[i] == 2)
+            continue;
+        
+        Address rxReg = Traits::memSizeReg(i, false);
+        Address txReg = Traits::memSizeReg(i, true);
+        if(txReg == rxReg + 1)
+        {
+            uint8_t sizes[2] = {Traits::memSizeValue(0, i, config.rxMemKb[i]),
+                                Traits::memSizeValue(0, i, config.txMemKb[i])};
+            writeBuffer(rxReg, sizes, 2);
+        
+        }else{
+            
+            writeRegister(rxReg, Traits::memSizeValue(0, i, config.rxMemKb[i]));
+            writeRegister(txReg, Traits::memSizeValue(0, i, config.txMemKb[i]));
+        }
+    }
+    
+    if(Traits::MEM_SIZE_SHARED)
+    {
+        putConfigRegister(image, Traits::memSizeReg(0, false), rxShared);
+        putConfigRegister(image, Traits::memSizeReg(0, true), txShared);
+    }
+    
+    layoutBuffers();
+    writeBuffer(Traits::MR, image, imageSize);
+    
+    if(!verify)
+        return true;
+    
+    uint8_t readBack[imageSize];
+    readBuffer(Traits::MR, readBack, imageSize);
+    
+    /* interface mode bits may be set in MR by the bus policy */
+    if((readBack[0] ^ image[0]) & ~Traits::MR_INTERFACE_BITS)
+        return false;
+    
+    /* only the bytes of the configured registers are compared, the
+       others of the block hold reserved or read-only registers */
+    const Address fields[][2] =
+    {
+        {Traits::GAR, 4}, {Traits::SUBR, 4}, {Traits::SHAR, 6},
+        {Traits::SIPR, 4}, {Traits::RTR, 2}, {Traits::RCR, 1}
+    };
+    
+    for(unsigned int f = 0; f < sizeof(fields) / sizeof(fields[0]); f++)
+    {
+        uint16_t offset = fields[f][0] - Traits::MR;
+        if(!std::equal(readBack + offset, readBack + offset + fields[f][1], image + offset))
+            return false;
+    }
+    
+    bool ok = checkConfigRegister(readBack, Traits::IMR, intMask);
+    if(!Traits::SOCK_IMR_SHARED)
+        ok = ok && checkConfigRegister(readBack, Traits::SOCK_IMR, sockIntMask);
+    
+    if(Traits::MEM_SIZE_SHARED)
+    {
+        ok = ok && checkConfigRegister(readBack, Traits::memSizeReg(0, false), rxShared)
+                && checkConfigRegister(readBack, Traits::memSizeReg(0, true), txShared);
+    
+    }else{
+        
+        for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM && ok; i++)
+        {
+            ok = checkConfigRegister(readBack, Traits::memSizeReg(i, false),
+                                     Traits::memSizeValue(0, i, config.rxMemKb[i])) &&
+                 checkConfigRegister(readBack, Traits::memSizeReg(i, true),
+                                     Traits::memSizeValue(0, i, config.txMemKb[i]));
+        }
+    }
+    
+    return ok;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::putConfigRegister(uint8_t* image, Address address, uint8_t value)
+{
+    if(address >= Traits::MR && address < Traits::COMMON_BLOCK_END)
+        image[address - Traits::MR] = value;
+    else
+        writeRegister(address, value);
+}
+
+template<class Traits, class Transport>
+bool W5x00Core<Traits, Transport>::checkConfigRegister(const uint8_t* image, Address address, uint8_t value)
+{
+    if(address >= Traits::MR && address < Traits::COMMON_BLOCK_END)
+        return image[address - Traits::MR] == value;
+    
+    return readRegister(address) == value;
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::startSpiTrace(SpiTraceRecord* ring, uint32_t size, TimestampHook clock)
+{
+    LockGuard<DriverMutex> lock(busMutex);
+    trace.start(ring, size, clock);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::stopSpiTrace()
+{
+    LockGuard<DriverMutex> lock(busMutex);
+    trace.stop();
+}
+
+template<class Traits, class Transport>
+uint32_t W5x00Core<Traits, Transport>::readSpiTrace(SpiTraceHeader& header, SpiTraceRecord* records,
+                                                    uint32_t max)
+{
+    LockGuard<DriverMutex> lock(busMutex);
+    return trace.read(header, Traits::CHIP_ID, records, max);
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::socketOf(Address address, SpiOperation op) const
+{
+    for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+    {
+        Address base;
+        uint32_t range;
+        
+        if(op == SPI_REG_READ || op == SPI_REG_WRITE)
+        {
+            base = Traits::socketReg(i, 0);
+            range = 0x100;
+        
+        }else if(Traits::BUFFER_WRAP_IN_CHIP){
+            
+            /* buffers are addressed by socket's pointers, within a block */
+            base = op == SPI_BUF_WRITE ? Traits::txBuffer(i, 0) : Traits::rxBuffer(i, 0);
+            range = 0x10000;
+        
+        }else{
+            
+            base = op == SPI_BUF_WRITE ? Traits::txBuffer(i, txBufBase[i])
+                                       : Traits::rxBuffer(i, rxBufBase[i]);
+            range = op == SPI_BUF_WRITE ? txBufSize[i] : rxBufSize[i];
+        }
+        
+        if(static_cast<Address>(address - base) < range)
+            return i;
+    }
+    
+    return SPI_TRACE_NO_SOCKET;
+}
+
+template<class Traits, class Transport>
+uint16_t W5x00Core<Traits, Transport>::getReceivedSize(SOCKET sockNum)
+{
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    
+    /* RECV command updates the received size register */
+    waitCommand(sockNum);
+    uint16_t size = readRegister16(Traits::socketReg(sockNum, Sn_RX_RSR0));
+    perf.received(sockNum, size);
+    return size;
+}
+
+template<class Traits, class Transport>
+uint16_t W5x00Core<Traits, Transport>::getTxFreeSize(SOCKET sockNum)
+{
+    return readRegister16(Traits::socketReg(sockNum, Sn_TX_FSR0));
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::pollSockets(uint8_t sockMask, SocketPollInfo* info)
+{
+    uint8_t ready = 0;
+    uint8_t regs[8];
+    uint8_t pending = readRegister(Traits::SOCK_IR) & Traits::SOCK_IR_BITS;
+    
+    for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+    {
+        if((sockMask & (1 << i)) == 0)
+            continue;
+        
+        LockGuard<DriverMutex> lock(sockMutex[i]);
+        waitCommand(i);
+        
+        /* interrupt and status registers are adjacent, read them
+           together only if the socket has some flag set */
+        if(pending & (1 << i))
+        {
+            readBuffer(Traits::socketReg(i, Sn_IR), regs, 2);
+            info[i].flags = regs[0];
+            info[i].status = regs[1];
+            latency.flags(i, regs[0]);
+            timeline.flags(i, regs[0]);
+            
+            if(regs[0] != 0)
+            {
+                writeRegister(Traits::socketReg(i, Sn_IR), regs[0]);
+                perf.interrupts(i, regs[0]);
+            }
+        
+        }else{
+            
+            info[i].flags = 0;
+            info[i].status = readRegister(Traits::socketReg(i, Sn_SR));
+        }
+        
+        latency.status(i, info[i].status);
+        timeline.status(i, info[i].status);
+        
+        if(Traits::BURST_FRAMES)
+        {
+            /* TX free size, TX pointers and RX received size are contiguous,
+               one frame costs less than two with their header bytes */
+            readBuffer(Traits::socketReg(i, Sn_TX_FSR0), regs, 8);
+            info[i].txFree = (regs[0] << 8) | regs[1];
+            info[i].rxSize = (regs[6] << 8) | regs[7];
+        
+        }else{
+            
+            /* every byte is a frame, read only what is needed */
+            info[i].txFree = readRegister16(Traits::socketReg(i, Sn_TX_FSR0));
+            info[i].rxSize = readRegister16(Traits::socketReg(i, Sn_RX_RSR0));
+        }
+        
+        if(info[i].flags != 0 || info[i].rxSize != 0)
+            ready |= 1 << i;
+    }
+    
+    return ready;
+}
+
+template<class Traits, class Transport>
+uint16_t W5x00Core<Traits, Transport>::queueSocketEvents(SocketEventQueue& queue)
+{
+    uint16_t queued = 0;
+    uint8_t pending;
+    
+    for(unsigned int pass = 0; pass < INT_DRAIN_PASSES; pass++)
+    {
+        pending = readRegister(Traits::SOCK_IR) & Traits::SOCK_IR_BITS;
+        if(pending == 0)
+            break;
+        
+        for(SOCKET i = 0; i < Traits::MAX_SOCK_NUM; i++)
+        {
+            if((pending & (1 << i)) == 0)
+                continue;
+            
+            /* flags are left set on the chip until there is room for them,
+               the interrupt stays asserted and the next call queues them */
+            if(queue.full())
+                return queued;
+            
+            SocketEvent event;
+            event.socket = i;
+            event.flags = readRegister(Traits::socketReg(i, Sn_IR));
+            event.rxSize = 0;
+            writeRegister(Traits::socketReg(i, Sn_IR), event.flags);
+            perf.interrupts(i, event.flags);
+            latency.flags(i, event.flags);
+            timeline.flags(i, event.flags);
+            
+            if(event.flags & SOCKn_IR_RECV)
+                event.rxSize = readRegister16(Traits::socketReg(i, Sn_RX_RSR0));
+            
+            queue.push(event);
+            queued++;
+        }
+    }
+    
+    return queued;
+}
+
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::readData(SOCKET sockNum, uint8_t* data, uint16_t len)
+{
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    
+    uint16_t readPtr = readRegister16(Traits::socketReg(sockNum, Sn_RX_RD0));
+    
+    readRxBuf(sockNum, readPtr, data, len);
+    perf.read(sockNum, len, (readPtr & (rxBufSize[sockNum] - 1)) + len > rxBufSize[sockNum]);
+    
+    readPtr += len;
+    writeRegister16(Traits::socketReg(sockNum, Sn_RX_RD0), readPtr); //update read pointer value
+    latency.delivered(sockNum);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::skipData(SOCKET sockNum, uint16_t len)
+{
+    if(len == 0)
+        return;
+    
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    
+    uint16_t readPtr = readRegister16(Traits::socketReg(sockNum, Sn_RX_RD0));
+    readPtr += len;
+    writeRegister16(Traits::socketReg(sockNum, Sn_RX_RD0), readPtr);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::writeData(SOCKET sockNum, const uint8_t* data, uint16_t len)
+{
+    LockGuard<DriverMutex> lock(sockMutex[sockNum]);
+    
+    uint16_t writePtr = readRegister16(Traits::socketReg(sockNum, Sn_TX_WR0));
+    
+    writeTxBuf(sockNum, data, writePtr, len);
+    perf.write(sockNum, len, (writePtr & (txBufSize[sockNum] - 1)) + len > txBufSize[sockNum]);
+    
+    writePtr += len;
+    writeRegister16(Traits::socketReg(sockNum, Sn_TX_WR0), writePtr); //update write pointer value
+}
+
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::readRxBuf(SOCKET socket, uint16_t src, uint8_t* dst, uint16_t len)
+{
+    if(Traits::BUFFER_WRAP_IN_CHIP)
+    {
+        readBuffer(Traits::rxBuffer(socket, src), dst, len, SPI_BUF_READ);
+        return;
+    }
+    
+    /* the address mask value is equal to socket's size in byte minus one */
+    
+    uint16_t mask = rxBufSize[socket] - 1;
+    
+    /* the physical address at which reading process begins is base address plus
+       the logical and between src pointer and address mask */
+    
+    uint16_t offset = src & mask;
+    uint16_t sockBufBase = rxBufBase[socket];
+    
+    if(offset + len > rxBufSize[socket])
+    {
+        uint16_t size = rxBufSize[socket] - offset;
+        readBuffer(Traits::rxBuffer(socket, sockBufBase + offset), dst, size, SPI_BUF_READ);
+        readBuffer(Traits::rxBuffer(socket, sockBufBase), dst + size, len - size, SPI_BUF_READ);
+    
+    }else{
+        
+        readBuffer(Traits::rxBuffer(socket, sockBufBase + offset), dst, len, SPI_BUF_READ);
+    }
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::writeTxBuf(SOCKET socket, const uint8_t* src, uint16_t dst, uint16_t len)
+{
+    if(Traits::BUFFER_WRAP_IN_CHIP)
+    {
+        writeBuffer(Traits::txBuffer(socket, dst), src, len, SPI_BUF_WRITE);
+        return;
+    }
+    
+    /* the address mask value is equal to socket's size in byte minus one */
+    
+    uint16_t mask = txBufSize[socket] - 1;
+    
+    /* the physical address at which writing process begins is base address plus
+       the logical and between dst pointer and address mask */
+    
+    uint16_t offset = dst & mask;
+    uint16_t sockBufBase = txBufBase[socket];
+    
+    if(offset + len > txBufSize[socket])
+    {
+        uint16_t size = txBufSize[socket] - offset;
+        writeBuffer(Traits::txBuffer(socket, sockBufBase + offset), src, size, SPI_BUF_WRITE);
+        writeBuffer(Traits::txBuffer(socket, sockBufBase), src + size, len - size, SPI_BUF_WRITE);
+    
+    }else{
+        
+        writeBuffer(Traits::txBuffer(socket, sockBufBase + offset), src, len, SPI_BUF_WRITE);
+    }
+}
+
+template<class Traits, class Transport>
+uint8_t W5x00Core<Traits, Transport>::readRegister(Address address)
+{
+    uint8_t data;
+    LockGuard<DriverMutex> lock(busMutex);
+    
+    uint32_t start = latency.start();
+    uint32_t traced = trace.begin();
+    Traits::read(spi, address, &data, 1);
+    latency.frames(start, 1);
+    perf.transfer(SPI_REG_READ, 1, 1);
+    if(trace.enabled())
+        trace.record(traced, SPI_REG_READ, address, 1, socketOf(address, SPI_REG_READ));
+    return data;
+}
+
+template<class Traits, class Transport>
+uint16_t W5x00Core<Traits, Transport>::readRegister16(Address address)
+{
+    uint8_t data[2];
+    readBuffer(address, data, 2);
+    
+    return (data[0] << 8) | data[1];
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::readBuffer(Address address, uint8_t* data, uint16_t len,
+                                              SpiOperation op)
+{
+    if(len == 0)
+        return;
+    
+    LockGuard<DriverMutex> lock(busMutex);
+    
+    uint16_t frames = Traits::BURST_FRAMES ? 1 : len;
+    uint32_t start = latency.start();
+    uint32_t traced = trace.begin();
+    Traits::read(spi, address, data, len);
+    latency.frames(start, frames);
+    perf.transfer(op, frames, len);
+    if(trace.enabled())
+        trace.record(traced, op, address, len, socketOf(address, op));
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::writeRegister(Address address, uint8_t data)
+{
+    LockGuard<DriverMutex> lock(busMutex);
+    
+    uint32_t start = latency.start();
+    uint32_t traced = trace.begin();
+    Traits::write(spi, address, &data, 1);
+    latency.frames(start, 1);
+    perf.transfer(SPI_REG_WRITE, 1, 1);
+    if(trace.enabled())
+        trace.record(traced, SPI_REG_WRITE, address, 1, socketOf(address, SPI_REG_WRITE));
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::writeRegister16(Address address, uint16_t data)
+{
+    uint8_t bytes[2];
+    bytes[0] = static_cast<uint8_t>((data & 0xFF00) >> 8);
+    bytes[1] = static_cast<uint8_t>(data & 0x00FF);
+    
+    writeBuffer(address, bytes, 2);
+}
+
+template<class Traits, class Transport>
+void W5x00Core<Traits, Transport>::writeBuffer(Address address, const uint8_t* data, uint16_t len,
+                                               SpiOperation op)
+{
+    if(len == 0)
+        return;
+    
+    LockGuard<DriverMutex> lock(busMutex);
+    
+    uint16_t frames = Traits::BURST_FRAMES ? 1 : len;
+    uint32_t start = latency.start();
+    uint32_t traced = trace.begin();
+    Traits::write(spi, address, data, len);
+    latency.frames(start, frames);
+    perf.transfer(op, frames, len);
+    if(trace.enabled())
+        trace.record(traced, op, address, len, socketOf(address, op));
+}
+
+#endif // W5X00_CORE_IMPL_H
@@ -0,0 +1,119 @@
+/*
+ * Register layout and values shared by Wiznet W5x00 chips
+ * 
+ * Copyright (C) 2015  Silvano Seva
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#ifndef W5X00_DEFS_H
+#define W5X00_DEFS_H
+
+/** socket registers offsets, relative to each socket's register block **/
+
+const unsigned int Sn_MR               = 0x0000; //socket Mode register
+const unsigned int Sn_CR               = 0x0001; //socket command register
+const unsigned int Sn_IR               = 0x0002; //socket interrupt register
+const unsigned int Sn_SR               = 0x0003; //socket status register
+const unsigned int Sn_SPORT0           = 0x0004; //socket source port register
+const unsigned int Sn_DHAR0            = 0x0006; //socket destination MAC address register
+const unsigned int Sn_DIPR0            = 0x000C; //socket destination IP address register
+const unsigned int Sn_DPORT0           = 0x0010; //socket destination port register
+const unsigned int Sn_MSSR0            = 0x0012; //socket MSS in TCP mode
+const unsigned int Sn_PROTO            = 0x0014; //socket protocol number in IPRAW mode
+const unsigned int Sn_TOS              = 0x0015; //socket's IP header's Type of Service field value
+const unsigned int Sn_TTL              = 0x0016; //socket's IP header's TTL field value
+const unsigned int Sn_RXMEM_SIZE       = 0x001E; //socket's RX buffer size register (not on W5100)
+const unsigned int Sn_TXMEM_SIZE       = 0x001F; //socket's TX buffer size register (not on W5100)
+const unsigned int Sn_TX_FSR0          = 0x0020; //socket's TX buffer free size register
+const unsigned int Sn_TX_RD0           = 0x0022; //socket's TX buffer read pointer address
+const unsigned int Sn_TX_WR0           = 0x0024; //socket's TX buffer write pointer address
+const unsigned int Sn_RX_RSR0          = 0x0026; //socket's received data size register
+const unsigned int Sn_RX_RD0           = 0x0028; //socket's RX buffer read pointer address
+const unsigned int Sn_RX_WR0           = 0x002A; //socket's RX buffer write pointer address
+const unsigned int Sn_IMR              = 0x002C; //socket's interrupt mask register (not on W5100)
+const unsigned int Sn_FRAG0            = 0x002D; //socket's IP header's Fragment field value (not on W5100)
+
+
+/* SOCKn_MR values */
+const unsigned char SOCKn_MR_CLOSE     = 0x00;        //socket closed
+const unsigned char SOCKn_MR_TCP       = 0x01;        //TCP mode
+const unsigned char SOCKn_MR_UDP       = 0x02;        //UDP mode
+const unsigned char SOCKn_MR_IPRAW     = 0x03;        //IP layer raw socket
+const unsigned char SOCKn_MR_MACRAW    = 0x04;        //MAC layer raw socket
+const unsigned char SOCKn_MR_PPPOE     = 0x05;        //PPPoE mode
+const unsigned char SOCKn_MR_ND        = 0x20;        //No delayed ACK enable
+const unsigned char SOCKn_MR_MULTI     = 0x80;        //enable multicasting (only in UDP mode)
+
+/* SOCKn_CR values */
+const unsigned char SOCKn_CR_OPEN      = 0x01;        //initialize and open socket
+const unsigned char SOCKn_CR_LISTEN    = 0x02;        //wait connection request in TCP mode (Server mode)
+const unsigned char SOCKn_CR_CONNECT   = 0x04;        //send connection request in TCP mode (Client mode)
+const unsigned char SOCKn_CR_DISCON    = 0x08;        //disconnect request in TCP mode
+const unsigned char SOCKn_CR_CLOSE     = 0x10;        //close socket
+const unsigned char SOCKn_CR_SEND      = 0x20;        //send all data stored in TX buffer
+const unsigned char SOCKn_CR_SEND_MAC  = 0x21;        //send data with MAC address without ARP process (only in UDP mode)
+const unsigned char SOCKn_CR_SEND_KEEP = 0x22;        //check if TCP connection is still alive
+const unsigned char SOCKn_CR_RECV      = 0x40;        //receive data
+
+// #ifdef __DEF_IINCHIP_PPP__
+//     #define SOCKn_CR_PCON      0x23         
+//     #define SOCKn_CR_PDISCON       0x24         
+//     #define SOCKn_CR_PCR       0x25         
+//     #define SOCKn_CR_PCN       0x26        
+//     #define SOCKn_CR_PCJ       0x27        
+// #endif
+
+/* SOCKn_IR values */
+// #ifdef __DEF_IINCHIP_PPP__
+//     #define SOCKn_IR_PRECV     0x80        
+//     #define SOCKn_IR_PFAIL     0x40        
+//     #define SOCKn_IR_PNEXT     0x20        
+// #endif
+const unsigned char SOCKn_IR_CON       = 0x01;        //connection established
+const unsigned char SOCKn_IR_DISCON    = 0x02;        //disconnected (TCP mode)
+const unsigned char SOCKn_IR_RECV      = 0x04;        //some data received
+const unsigned char SOCKn_IR_TIMEOUT   = 0x08;        //Timeout occurred in ARP or TCP
+const unsigned char SOCKn_IR_SEND_OK   = 0x10;        //SEND command completed
+
+/* SOCKn_SR values */
+const unsigned char SOCK_CLOSED        = 0x00;        //socket closed
+const unsigned char SOCK_INIT          = 0x13;        //TCP init state
+const unsigned char SOCK_LISTEN        = 0x14;        //TCP server listen for connection state
+const unsigned char SOCK_SYNSENT       = 0x15;        //TCP connection request sent to server
+const unsigned char SOCK_SYNRECV       = 0x16;        //TCP connection request received from client
+const unsigned char SOCK_ESTABLISHED   = 0x17;        //TCP connection established
+const unsigned char SOCK_FIN_WAIT      = 0x18;        //TCP closing state
+const unsigned char SOCK_CLOSING       = 0x1A;        //TCP closing state
+const unsigned char SOCK_TIME_WAIT     = 0x1B;        //TCP closing state
+const unsigned char SOCK_CLOSE_WAIT    = 0x1C;        //TCP closing state
+const unsigned char SOCK_LAST_ACK      = 0x1D;        //TCP closing state
+const unsigned char SOCK_UDP           = 0x22;        //socket opened in UDP mode
+const unsigned char SOCK_IPRAW         = 0x32;        //socket opened in IP raw mode
+const unsigned char SOCK_MACRAW        = 0x42;        //socket opened in MAC raw mode
+const unsigned char SOCK_PPPOE         = 0x5F;        //socket opened in PPPoE mode
+
+/* IP PROTOCOL */
+const unsigned char IPPROTO_IP         = 0;           // Dummy for IP
+const unsigned char IPPROTO_ICMP       = 1;           // ICMP protocol
+const unsigned char IPPROTO_IGMP       = 2;           // IGMP protocol
+const unsigned char IPPROTO_GGP        = 3;           // GGP protocol
+const unsigned char IPPROTO_TCP        = 6;           // TCP
+const unsigned char IPPROTO_PUP        = 12;          // PUP
+const unsigned char IPPROTO_UDP        = 17;          // UDP
+const unsigned char IPPROTO_IDP        = 22;          // XNS idp
+const unsigned char IPPROTO_RAW        = 255;         // Raw IP packet */
+
+#endif // W5X00_DEFS_H
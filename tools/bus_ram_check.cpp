@@ -0,0 +1,168 @@
+/*
+ * Check of the W5100 parallel bus policies against plain RAM arrays
+ *
+ * Copyright (C) 2015  Silvano Seva
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Host tool, built with:
+ *   g++ -std=c++11 -IW5100 -Icommon tools/bus_ram_check.cpp -o bus_ram_check
+ *
+ * Usage: bus_ram_check
+ *
+ * DirectBus is given a RAM array standing for the chip's whole memory, and
+ * the driver built on it is run through bringUp() with verification and
+ * through socket buffer writes and reads wrapping at the buffer's end; the
+ * array is then checked to hold what the chip would.
+ * IndirectBus is given a RAM array standing for the four interface
+ * registers: as plain RAM does not auto-increment, the check is on the
+ * access sequence, that is address and data register contents after each
+ * access and mode register handling, including a software reset which
+ * never ends. Prints the failed checks, exit status is their number.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "w5100.h"
+
+namespace {
+
+/* stands for the chip's memory, 32kB on W5100 */
+volatile uint8 memory[0x8000];
+
+/* stands for the indirect mode interface registers */
+volatile uint8 registers[4];
+
+unsigned int failures = 0;
+
+void check(bool ok, const char *what)
+{
+    if(ok)
+        return;
+
+    printf("failed: %s\n", what);
+    failures++;
+}
+
+/* the chip clears MR_RST once the reset is over, RAM needs some help */
+void endReset(uint16_t)
+{
+    memory[MR] &= ~MR_RST;
+}
+
+const ChipConfig config = { 0x00, {0x00,0x08,0xdc,0x01,0x02,0x03}, {192,168,1,10},
+    {255,255,255,0}, {192,168,1,1}, 2000, 8, 0x00, 0x0F, {2,2,2,2}, {1,1,2,4} };
+
+void checkDirect()
+{
+    DirectBus bus(memory);
+    W5100T<DirectBus> chip(bus);
+    chip.setCommandWaitHook(endReset, 10);
+
+    check(chip.bringUp(config, true), "direct: bringUp verification");
+    check(memory[SIPR_BASE] == 192 && memory[SIPR_BASE + 3] == 10, "direct: source IP");
+    check(memory[TMSR] == 0x90 && memory[RMSR] == 0x55, "direct: memory sizes");
+
+    /* socket 3 has 4kB of TX memory after 1 + 1 + 2kB, write across its end */
+    uint8_t out[16];
+    for(unsigned int i = 0; i < sizeof(out); i++)
+        out[i] = i + 1;
+
+    uint16_t ptr = 0x1000 - 6;
+    memory[SOCKn_TX_WR0 + 3 * SR_SIZE] = ptr >> 8;
+    memory[SOCKn_TX_WR0 + 3 * SR_SIZE + 1] = ptr & 0xFF;
+    chip.writeData(3, out, sizeof(out));
+
+    uint16_t tx = TX_BUF_BASE + 0x1000;
+    check(memory[tx + 0x1000 - 6] == 1 && memory[tx + 0x0FFF] == 6 &&
+          memory[tx] == 7 && memory[tx + 9] == 16, "direct: TX buffer wrap");
+    check(((memory[SOCKn_TX_WR0 + 3 * SR_SIZE] << 8) | memory[SOCKn_TX_WR0 + 3 * SR_SIZE + 1]) ==
+          static_cast<uint16_t>(ptr + sizeof(out)), "direct: TX write pointer");
+
+    /* socket 1 has 2kB of RX memory after 2kB, read across its end */
+    uint16_t rx = RX_BUF_BASE + 0x0800;
+    for(unsigned int i = 0; i < 8; i++)
+        memory[i < 4 ? rx + 0x07FC + i : rx + i - 4] = 0xA0 + i;
+
+    ptr = 0x07FC;
+    memory[SOCKn_RX_RD0 + SR_SIZE] = ptr >> 8;
+    memory[SOCKn_RX_RD0 + SR_SIZE + 1] = ptr & 0xFF;
+
+    uint8_t in[8];
+    chip.readData(1, in, sizeof(in));
+
+    bool same = true;
+    for(unsigned int i = 0; i < sizeof(in); i++)
+        same = same && in[i] == 0xA0 + i;
+
+    check(same, "direct: RX buffer wrap");
+    check(((memory[SOCKn_RX_RD0 + SR_SIZE] << 8) | memory[SOCKn_RX_RD0 + SR_SIZE + 1]) ==
+          static_cast<uint16_t>(ptr + sizeof(in)), "direct: RX read pointer");
+}
+
+void checkIndirect()
+{
+    IndirectBus bus(registers);
+    bus.init();
+    check(registers[IDM_MR] == (MR_IND | MR_AI), "indirect: interface mode set by init");
+
+    uint8_t data[3] = {0x11, 0x22, 0x33};
+    bus.write(SOCKn_TX_WR0 + SR_SIZE, data, 3);
+    check(registers[IDM_AR0] == 0x05 && registers[IDM_AR1] == 0x24, "indirect: write address");
+    check(registers[IDM_DR] == 0x33, "indirect: write data");
+
+    /* a block starting at MR writes it directly, the rest through DR */
+    uint8_t mode[2] = {MR_PB, 0xC0};
+    bus.write(MR, mode, 2);
+    check(registers[IDM_MR] == (MR_PB | MR_IND | MR_AI), "indirect: mode keeps interface bits");
+    check(registers[IDM_AR0] == 0x00 && registers[IDM_AR1] == 0x01 &&
+          registers[IDM_DR] == 0xC0, "indirect: block following MR");
+
+    registers[IDM_DR] = 0x5A;
+    uint8_t in[2] = {0, 0};
+    bus.read(SIPR_BASE, in, 2);
+    check(registers[IDM_AR0] == 0x00 && registers[IDM_AR1] == SIPR_BASE, "indirect: read address");
+    check(in[0] == 0x5A && in[1] == 0x5A, "indirect: read data");
+
+    /* RAM keeps MR_RST set, the wait has to be given up */
+    uint8_t reset = MR_RST;
+    bus.write(MR, &reset, 1);
+    check(registers[IDM_MR] == (MR_IND | MR_AI), "indirect: interface mode restored after reset");
+}
+
+} // namespace
+
+void Bus_init()
+{
+
+}
+
+volatile uint8 *Bus_base()
+{
+    return memory;
+}
+
+int main()
+{
+    checkDirect();
+    checkIndirect();
+
+    if(failures == 0)
+        printf("all checks passed\n");
+
+    return failures;
+}
@@ -0,0 +1,265 @@
+/*
+ * Decoder of the SPI traces recorded by the drivers
+ *
+ * Copyright (C) 2015  Silvano Seva
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Host tool, build with:
+ *   g++ -std=c++11 -O2 -Icommon tools/spi_trace_decode.cpp -o spi_trace_decode
+ *
+ * Usage: spi_trace_decode [-t] trace_file
+ * prints the cost of the accesses by socket and by register and, with -t,
+ * the timeline of all of them. Costs are in the trace's timestamp ticks;
+ * wire bytes are the bytes clocked on the SPI bus, frame headers included.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "spi_trace.h"
+
+namespace {
+
+struct Cost
+{
+    Cost() : accesses(0), bytes(0), wireBytes(0), ticks(0) { }
+
+    void add(const SpiTraceRecord& r, uint32_t wire)
+    {
+        accesses++;
+        bytes += r.len;
+        wireBytes += wire;
+        ticks += r.duration;
+    }
+
+    uint64_t accesses;
+    uint64_t bytes;
+    uint64_t wireBytes;
+    uint64_t ticks;
+};
+
+struct Name
+{
+    unsigned int offset;
+    const char *name;
+};
+
+/* socket registers, from w5x00_defs.h, each entry spans up to the next */
+const Name socketRegs[] =
+{
+    {0x00, "Sn_MR"}, {0x01, "Sn_CR"}, {0x02, "Sn_IR"}, {0x03, "Sn_SR"},
+    {0x04, "Sn_PORT"}, {0x06, "Sn_DHAR"}, {0x0C, "Sn_DIPR"},
+    {0x10, "Sn_DPORT"}, {0x12, "Sn_MSSR"}, {0x14, "Sn_PROTO"},
+    {0x15, "Sn_TOS"}, {0x16, "Sn_TTL"}, {0x17, "Sn_?"},
+    {0x1E, "Sn_RXMEM_SIZE"}, {0x1F, "Sn_TXMEM_SIZE"}, {0x20, "Sn_TX_FSR"},
+    {0x22, "Sn_TX_RD"}, {0x24, "Sn_TX_WR"}, {0x26, "Sn_RX_RSR"},
+    {0x28, "Sn_RX_RD"}, {0x2A, "Sn_RX_WR"}, {0x2C, "Sn_IMR"},
+    {0x2D, "Sn_FRAG"}, {0x2F, "Sn_?"}, {0x100, 0}
+};
+
+/* common registers, the low ones are at the same place on all chips */
+const Name commonRegs5100[] =
+{
+    {0x00, "MR"}, {0x01, "GAR"}, {0x05, "SUBR"}, {0x09, "SHAR"},
+    {0x0F, "SIPR"}, {0x13, "?"}, {0x15, "IR"}, {0x16, "IMR"}, {0x17, "RTR"},
+    {0x19, "RCR"}, {0x1A, "RMSR"}, {0x1B, "TMSR"}, {0x1C, "PATR"},
+    {0x28, "PTIMER"}, {0x29, "PMAGIC"}, {0x2A, "UIPR"}, {0x2E, "UPORT"},
+    {0x30, "?"}, {0x10000, 0}
+};
+
+const Name commonRegs5200[] =
+{
+    {0x00, "MR"}, {0x01, "GAR"}, {0x05, "SUBR"}, {0x09, "SHAR"},
+    {0x0F, "SIPR"}, {0x13, "?"}, {0x15, "IR"}, {0x16, "IMR"}, {0x17, "RTR"},
+    {0x19, "RCR"}, {0x1A, "?"}, {0x1C, "PATR"}, {0x1E, "?"},
+    {0x1F, "VERSIONR"}, {0x20, "?"}, {0x28, "PTIMER"}, {0x29, "PMAGIC"},
+    {0x2A, "?"}, {0x30, "INTLEVEL"}, {0x32, "?"}, {0x34, "IR2"},
+    {0x35, "PSTATUS"}, {0x36, "IMR2"}, {0x37, "?"}, {0x10000, 0}
+};
+
+const Name commonRegs5500[] =
+{
+    {0x00, "MR"}, {0x01, "GAR"}, {0x05, "SUBR"}, {0x09, "SHAR"},
+    {0x0F, "SIPR"}, {0x13, "INTLEVEL"}, {0x15, "IR"}, {0x16, "IMR"},
+    {0x17, "SIR"}, {0x18, "SIMR"}, {0x19, "RTR"}, {0x1B, "RCR"},
+    {0x1C, "PTIMER"}, {0x1D, "PMAGIC"}, {0x1E, "PHAR"}, {0x24, "PSID"},
+    {0x26, "PMRU"}, {0x28, "UIPR"}, {0x2C, "UPORTR"}, {0x2E, "PHYCFGR"},
+    {0x2F, "?"}, {0x39, "VERSIONR"}, {0x3A, "?"}, {0x10000, 0}
+};
+
+const char *lookup(const Name *table, unsigned int offset)
+{
+    const char *name = "?";
+    for(; table->name && table->offset <= offset; table++)
+        name = table->name;
+
+    return name;
+}
+
+const char *opName(uint8_t op)
+{
+    static const char *names[] = {"reg rd", "reg wr", "buf rd", "buf wr"};
+    return op < SPI_OPERATIONS ? names[op] : "?";
+}
+
+/* name of the register or buffer accessed */
+std::string target(const SpiTraceRecord& r, uint16_t chip)
+{
+    if(r.op == SPI_BUF_READ)
+        return "RX buffer";
+
+    if(r.op == SPI_BUF_WRITE)
+        return "TX buffer";
+
+    /* W5500 addresses carry the block in bits 16 and up */
+    unsigned int offset = chip == 5500 ? r.address & 0xFFFF : r.address;
+
+    if(r.socket != SPI_TRACE_NO_SOCKET)
+        return lookup(socketRegs, offset & 0xFF);
+
+    const Name *table = chip == 5100 ? commonRegs5100 :
+                        chip == 5200 ? commonRegs5200 : commonRegs5500;
+    return lookup(table, offset);
+}
+
+/* bytes on the bus, frame headers included */
+uint32_t wireBytes(const SpiTraceRecord& r, uint16_t chip)
+{
+    switch(chip)
+    {
+        case 5100: return 4 * r.len;        //one 4 bytes frame per byte
+        case 5200: return 4 + r.len;        //4 bytes header
+        default:   return 3 + r.len;        //3 bytes header
+    }
+}
+
+std::string socketName(uint8_t socket)
+{
+    if(socket == SPI_TRACE_NO_SOCKET)
+        return "common";
+
+    char s[8];
+    snprintf(s, sizeof(s), "S%u", socket);
+    return s;
+}
+
+void printHeading(const char *what)
+{
+    printf("%-24s %10s %10s %10s %12s %10s %6s\n", what, "accesses",
+           "bytes", "wire", "ticks", "ticks/acc", "time%");
+}
+
+void printCost(const std::string& what, const Cost& c, uint64_t total)
+{
+    printf("%-24s %10llu %10llu %10llu %12llu %10.1f %5.1f%%\n", what.c_str(),
+           (unsigned long long) c.accesses, (unsigned long long) c.bytes,
+           (unsigned long long) c.wireBytes, (unsigned long long) c.ticks,
+           c.accesses ? (double) c.ticks / c.accesses : 0.0,
+           total ? 100.0 * c.ticks / total : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool timeline = false;
+    const char *path = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-t") == 0)
+            timeline = true;
+        else
+            path = argv[i];
+    }
+
+    if(!path)
+    {
+        fprintf(stderr, "usage: %s [-t] trace_file\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if(!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    SpiTraceHeader header;
+    if(fread(&header, sizeof(header), 1, f) != 1 ||
+       memcmp(header.magic, "W5TR", 4) != 0 ||
+       header.version != SPI_TRACE_VERSION ||
+       header.recordSize != sizeof(SpiTraceRecord))
+    {
+        fprintf(stderr, "%s: not a trace, or saved by a different version\n", path);
+        return 1;
+    }
+
+    std::vector<SpiTraceRecord> records(header.count);
+    size_t n = header.count ? fread(&records[0], sizeof(SpiTraceRecord), header.count, f) : 0;
+    fclose(f);
+    records.resize(n);
+
+    printf("W%u trace, %zu accesses", header.chip, n);
+    if(header.dropped)
+        printf(", %u older ones overwritten", header.dropped);
+    printf("\n\n");
+
+    std::map<std::string, Cost> bySocket;
+    std::map<std::string, Cost> byRegister;
+    Cost total;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        const SpiTraceRecord& r = records[i];
+        std::string sock = socketName(r.socket);
+        std::string reg = target(r, header.chip);
+        uint32_t wire = wireBytes(r, header.chip);
+
+        bySocket[sock + " " + opName(r.op)].add(r, wire);
+        byRegister[sock + " " + reg + " " + opName(r.op)].add(r, wire);
+        total.add(r, wire);
+
+        if(timeline)
+            printf("%10u %6u  %-6s %-6s %-14s %5u\n", r.time, r.duration,
+                   sock.c_str(), opName(r.op), reg.c_str(), r.len);
+    }
+
+    if(timeline)
+        printf("\n");
+
+    printHeading("socket, operation");
+    for(std::map<std::string, Cost>::const_iterator it = bySocket.begin(); it != bySocket.end(); ++it)
+        printCost(it->first, it->second, total.ticks);
+    printCost("total", total, total.ticks);
+
+    printf("\n");
+    printHeading("socket, register");
+    for(std::map<std::string, Cost>::const_iterator it = byRegister.begin(); it != byRegister.end(); ++it)
+        printCost(it->first, it->second, total.ticks);
+
+    if(n > 1)
+        printf("\nspan %u ticks, bus busy %.1f%%\n", records[n - 1].time - records[0].time,
+               100.0 * total.ticks / (records[n - 1].time - records[0].time + records[n - 1].duration));
+
+    return 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * Replay of the SPI traces recorded by the drivers against a chip simulator
+ *
+ * Copyright (C) 2015  Silvano Seva
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Host tool, built once per chip against that chip's driver, for example:
+ *   g++ -std=c++11 -O2 -DREPLAY_W5500 -IW5500 -Icommon \
+ *       tools/spi_trace_replay.cpp -o spi_trace_replay_w5500
+ *
+ * Usage: spi_trace_replay [-f spi_mhz] [-g gap_ns] [-k ticks_per_us] trace_file
+ *
+ * Every access of the trace is encoded by the driver's traits class, as the
+ * driver would do on the target, and clocked into a simulator of the chip's
+ * SPI interface and memory, which decodes the frames back and checks they
+ * reach the traced address. The tool then reports frames, bus bytes and
+ * the bus time they take at the given SPI clock, with gap_ns of chip select
+ * overhead per frame, so that changes to the frame encoding or to the SPI
+ * setup can be evaluated on a workload captured in the field. With -k the
+ * traced durations are converted to microseconds and reported alongside.
+ * Payload data is not traced, data written is replayed as zeros.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if defined(REPLAY_W5100)
+#include "w5100.h"
+typedef W5100Traits ChipTraits;
+#elif defined(REPLAY_W5200)
+#include "w5200.h"
+typedef W5200Traits ChipTraits;
+#elif defined(REPLAY_W5500)
+#include "w5500.h"
+typedef W5500Traits ChipTraits;
+#else
+#error "define REPLAY_W5100, REPLAY_W5200 or REPLAY_W5500"
+#endif
+
+namespace {
+
+/**
+ * Chip's SPI interface and memory: frames are decoded from the bytes
+ * clocked in while chip select is low
+ */
+class ChipSimulator
+{
+public:
+    ChipSimulator() : memory(32 << 16), state(0), address(0), block(0),
+        write(false), frames(0), bytes(0) { }
+
+    void select()
+    {
+        state = 0;
+        frames++;
+    }
+
+    unsigned char transfer(unsigned char data)
+    {
+        bytes++;
+
+        if(state < HEADER)
+        {
+            header(data);
+            state++;
+            if(state == HEADER)
+                firstAddress.push_back(address | (block << 16));
+
+            return 0;
+        }
+
+        uint8_t& cell = memory[(block << 16) | address];
+        unsigned char r = write ? 0 : cell;
+        if(write)
+            cell = data;
+
+        address = (address + 1) & 0xFFFF;
+        return r;
+    }
+
+    std::vector<uint8_t> memory;        //32 blocks of 64kB, one on W5100/W5200
+    std::vector<uint32_t> firstAddress; //address of each frame
+    unsigned int state;                 //header bytes received in current frame
+    uint32_t address;
+    uint32_t block;
+    bool write;
+    uint64_t frames;
+    uint64_t bytes;
+
+private:
+
+#if defined(REPLAY_W5100)
+    /* op code, address high, address low, then one data byte */
+    static const unsigned int HEADER = 3;
+
+    void header(unsigned char data)
+    {
+        switch(state)
+        {
+            case 0: write = data == 0xF0; break;
+            case 1: address = data << 8; break;
+            case 2: address |= data; break;
+        }
+    }
+#elif defined(REPLAY_W5200)
+    /* address high, address low, write flag and length high, length low */
+    static const unsigned int HEADER = 4;
+
+    void header(unsigned char data)
+    {
+        switch(state)
+        {
+            case 0: address = data << 8; break;
+            case 1: address |= data; break;
+            case 2: write = (data & 0x80) != 0; break;
+            case 3: break;
+        }
+    }
+#else
+    /* address high, address low, block select and write flag */
+    static const unsigned int HEADER = 3;
+
+    void header(unsigned char data)
+    {
+        switch(state)
+        {
+            case 0: address = data << 8; break;
+            case 1: address |= data; break;
+            case 2: block = data >> 3; write = (data & 0x04) != 0; break;
+        }
+    }
+#endif
+};
+
+/**
+ * SPI transport policy attached to the simulator
+ */
+class SimTransport
+{
+public:
+    explicit SimTransport(ChipSimulator& sim) : sim(&sim) { }
+
+    void init() { }
+    void select() { sim->select(); }
+    void deselect() { }
+    unsigned char transfer(unsigned char data) { return sim->transfer(data); }
+
+private:
+    ChipSimulator *sim;
+};
+
+struct Totals
+{
+    Totals() : accesses(0), frames(0), bytes(0), ticks(0) { }
+
+    uint64_t accesses;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t ticks;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    double mhz = 10.0;
+    double gapNs = 100.0;
+    double ticksPerUs = 0.0;
+    const char *path = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            mhz = atof(argv[++i]);
+        else if(strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            gapNs = atof(argv[++i]);
+        else if(strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            ticksPerUs = atof(argv[++i]);
+        else
+            path = argv[i];
+    }
+
+    if(!path || mhz <= 0.0)
+    {
+        fprintf(stderr, "usage: %s [-f spi_mhz] [-g gap_ns] [-k ticks_per_us] trace_file\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if(!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    SpiTraceHeader header;
+    if(fread(&header, sizeof(header), 1, f) != 1 ||
+       memcmp(header.magic, "W5TR", 4) != 0 ||
+       header.version != SPI_TRACE_VERSION ||
+       header.recordSize != sizeof(SpiTraceRecord))
+    {
+        fprintf(stderr, "%s: not a trace, or saved by a different version\n", path);
+        return 1;
+    }
+
+    if(header.chip != ChipTraits::CHIP_ID)
+    {
+        fprintf(stderr, "%s: W%u trace, this replay is built for W%u\n", path,
+                header.chip, ChipTraits::CHIP_ID);
+        return 1;
+    }
+
+    std::vector<SpiTraceRecord> records(header.count);
+    size_t n = header.count ? fread(&records[0], sizeof(SpiTraceRecord), header.count, f) : 0;
+    fclose(f);
+
+    ChipSimulator sim;
+    SimTransport spi(sim);
+    std::vector<uint8_t> data(0x10000);
+    Totals totals[SPI_OPERATIONS];
+    uint64_t mismatches = 0;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        const SpiTraceRecord& r = records[i];
+        if(r.op >= SPI_OPERATIONS || r.len == 0)
+            continue;
+
+        uint64_t frames = sim.frames;
+        uint64_t bytes = sim.bytes;
+        size_t first = sim.firstAddress.size();
+        ChipTraits::Address address = static_cast<ChipTraits::Address>(r.address);
+
+        if(r.op == SPI_REG_READ || r.op == SPI_BUF_READ)
+        {
+            ChipTraits::read(spi, address, &data[0], r.len);
+
+        }else{
+
+            memset(&data[0], 0, r.len);
+            ChipTraits::write(spi, address, &data[0], r.len);
+        }
+
+        /* the first frame has to address what the driver accessed */
+        if(sim.firstAddress.size() == first || sim.firstAddress[first] != r.address)
+            mismatches++;
+
+        sim.firstAddress.clear();
+
+        Totals& t = totals[r.op];
+        t.accesses++;
+        t.frames += sim.frames - frames;
+        t.bytes += sim.bytes - bytes;
+        t.ticks += r.duration;
+    }
+
+    static const char *names[] = {"register read", "register write",
+                                  "buffer read", "buffer write"};
+
+    printf("W%u trace, %zu accesses replayed at %.1f MHz, %.0f ns per frame\n\n",
+           header.chip, n, mhz, gapNs);
+    printf("%-16s %10s %10s %10s %12s", "operation", "accesses", "frames",
+           "bus bytes", "bus us");
+    if(ticksPerUs > 0.0)
+        printf(" %12s", "traced us");
+    printf("\n");
+
+    Totals sum;
+    for(int op = 0; op < SPI_OPERATIONS; op++)
+    {
+        const Totals& t = totals[op];
+        double us = t.bytes * 8.0 / mhz + t.frames * gapNs / 1000.0;
+
+        printf("%-16s %10llu %10llu %10llu %12.1f", names[op],
+               (unsigned long long) t.accesses, (unsigned long long) t.frames,
+               (unsigned long long) t.bytes, us);
+        if(ticksPerUs > 0.0)
+            printf(" %12.1f", t.ticks / ticksPerUs);
+        printf("\n");
+
+        sum.accesses += t.accesses;
+        sum.frames += t.frames;
+        sum.bytes += t.bytes;
+        sum.ticks += t.ticks;
+    }
+
+    double us = sum.bytes * 8.0 / mhz + sum.frames * gapNs / 1000.0;
+    printf("%-16s %10llu %10llu %10llu %12.1f", "total",
+           (unsigned long long) sum.accesses, (unsigned long long) sum.frames,
+           (unsigned long long) sum.bytes, us);
+    if(ticksPerUs > 0.0)
+        printf(" %12.1f", sum.ticks / ticksPerUs);
+    printf("\n");
+
+    if(mismatches)
+    {
+        printf("\n%llu accesses did not reach the traced address\n",
+               (unsigned long long) mismatches);
+        return 2;
+    }
+
+    return 0;
+}